@@ -0,0 +1,316 @@
+#include <benchmark/benchmark.h>
+
+#include "ArchiveGenerator.h"
+
+#include <ZipCpp/LazyArchive.h>
+
+#include <cstdio>
+#include <fstream>
+#include <vector>
+
+// Archive shapes: many tiny entries and few huge entries,
+// each with compressible and random data.
+
+static const std::size_t TinyEntries = 10000;
+static const std::size_t TinySize = 256;
+static const std::size_t HugeEntries = 4;
+static const std::size_t HugeSize = 16 * 1024 * 1024;
+
+static void ArchiveShapes(benchmark::internal::Benchmark* b)
+{
+	b->ArgNames({ "entries", "size", "random" });
+
+	for (int random = 0; random <= 1; random++) {
+		b->Args({ (long) TinyEntries, (long) TinySize, random });
+		b->Args({ (long) HugeEntries, (long) HugeSize, random });
+	}
+}
+
+static Bench::DataKind KindOf(const benchmark::State& state)
+{
+	return state.range(2) ? Bench::DataKind::Random : Bench::DataKind::Compressible;
+}
+
+static void ReportMemory(benchmark::State& state)
+{
+	state.counters["peak_rss_kib"] = Bench::PeakRssKiB();
+}
+
+static void BM_GetEntryList(benchmark::State& state)
+{
+	std::istringstream ss(Bench::GetArchive(state.range(0), state.range(1), KindOf(state)));
+	auto ar = Zip::MakeInputArchive(&ss);
+
+	for (auto _ : state) {
+		benchmark::DoNotOptimize(ar.getEntryList());
+	}
+
+	state.SetItemsProcessed(state.iterations() * state.range(0));
+	ReportMemory(state);
+}
+
+BENCHMARK(BM_GetEntryList)->Apply(ArchiveShapes);
+
+static void BM_OpenArchive(benchmark::State& state)
+{
+	const std::string& data = Bench::GetArchive(state.range(0), state.range(1), KindOf(state));
+
+	for (auto _ : state) {
+		std::istringstream ss(data);
+		auto ar = Zip::MakeInputArchive(&ss);
+		benchmark::DoNotOptimize(ar.getNumOfEntries());
+	}
+
+	ReportMemory(state);
+}
+
+BENCHMARK(BM_OpenArchive)->Apply(ArchiveShapes);
+
+// opening an archive to read one entry, libzip parses the whole central directory
+static void BM_OpenAndReadOne(benchmark::State& state)
+{
+	const std::string& data = Bench::GetArchive(state.range(0), state.range(1), KindOf(state));
+
+	std::vector<char> buffer;
+
+	for (auto _ : state) {
+		auto ar = Zip::MakeInputArchive(data.data(), data.size());
+		benchmark::DoNotOptimize(ar.readEntry(0, buffer));
+	}
+
+	ReportMemory(state);
+}
+
+BENCHMARK(BM_OpenAndReadOne)->Apply(ArchiveShapes);
+
+static void BM_LazyOpenAndReadOne(benchmark::State& state)
+{
+	const std::string& data = Bench::GetArchive(state.range(0), state.range(1), KindOf(state));
+
+	std::vector<char> buffer;
+
+	for (auto _ : state) {
+		Zip::LazyArchive ar(data.data(), data.size());
+		benchmark::DoNotOptimize(ar.readEntry(Bench::MakeEntryName(0), buffer));
+	}
+
+	ReportMemory(state);
+}
+
+BENCHMARK(BM_LazyOpenAndReadOne)->Apply(ArchiveShapes);
+
+// opening with a sidecar index, as short-lived processes do
+static void BM_IndexedOpenAndReadOne(benchmark::State& state)
+{
+	const std::string& data = Bench::GetArchive(state.range(0), state.range(1), KindOf(state));
+
+	const char* filePath = "BM_IndexedOpenAndReadOne.zip";
+	const char* indexPath = "BM_IndexedOpenAndReadOne.idx";
+
+	{
+		std::ofstream fs(filePath, std::ios::binary);
+		fs.write(data.data(), data.size());
+	}
+
+	std::remove(indexPath);
+	Zip::OpenLazyArchive(filePath, indexPath);
+
+	std::vector<char> buffer;
+	std::string entryPath = Bench::MakeEntryName(state.range(0) - 1);
+
+	for (auto _ : state) {
+		auto ar = Zip::OpenLazyArchive(filePath, indexPath);
+		benchmark::DoNotOptimize(ar->readEntry(entryPath, buffer));
+	}
+
+	std::remove(indexPath);
+	std::remove(filePath);
+
+	ReportMemory(state);
+}
+
+BENCHMARK(BM_IndexedOpenAndReadOne)->Apply(ArchiveShapes);
+
+static void BM_EntryLookup(benchmark::State& state)
+{
+	std::istringstream ss(Bench::GetArchive(state.range(0), state.range(1), KindOf(state)));
+	auto ar = Zip::MakeInputArchive(&ss);
+
+	std::vector<std::string> names;
+
+	for (std::size_t i = 0; i < (std::size_t) state.range(0); i++) {
+		names.push_back(Bench::MakeEntryName((i * 7919) % state.range(0)));
+	}
+
+	std::size_t i = 0;
+
+	for (auto _ : state) {
+		benchmark::DoNotOptimize(ar.entry(names[i]).getIndex());
+		i = (i + 1) % names.size();
+	}
+
+	state.SetItemsProcessed(state.iterations());
+	ReportMemory(state);
+}
+
+BENCHMARK(BM_EntryLookup)->Apply(ArchiveShapes);
+
+static void BM_ExportTo(benchmark::State& state)
+{
+	std::istringstream ss(Bench::GetArchive(state.range(0), state.range(1), KindOf(state)));
+	auto ar = Zip::MakeInputArchive(&ss);
+
+	for (auto _ : state) {
+
+		for (std::size_t i = 0; i < (std::size_t) state.range(0); i++) {
+
+			std::size_t size = 0;
+
+			ar.entry(Bench::MakeEntryName(i)).exportTo(
+				[&size](const char*, std::size_t len)
+				{
+					size += len;
+				}
+			);
+
+			benchmark::DoNotOptimize(size);
+		}
+
+	}
+
+	state.SetBytesProcessed(state.iterations() * state.range(0) * state.range(1));
+	ReportMemory(state);
+}
+
+BENCHMARK(BM_ExportTo)->Apply(ArchiveShapes)->Unit(benchmark::kMillisecond);
+
+static void BM_ReadEntry(benchmark::State& state)
+{
+	std::istringstream ss(Bench::GetArchive(state.range(0), state.range(1), KindOf(state)));
+	auto ar = Zip::MakeInputArchive(&ss);
+
+	std::vector<char> buffer;
+
+	for (auto _ : state) {
+
+		for (std::size_t i = 0; i < (std::size_t) state.range(0); i++) {
+			benchmark::DoNotOptimize(ar.readEntry(i, buffer));
+		}
+
+	}
+
+	state.SetBytesProcessed(state.iterations() * state.range(0) * state.range(1));
+	ReportMemory(state);
+}
+
+BENCHMARK(BM_ReadEntry)->Apply(ArchiveShapes)->Unit(benchmark::kMillisecond);
+
+// stored entries read with each Zip::CrcCheck mode, Default is the libzip check
+static void BM_ExportStored(benchmark::State& state)
+{
+	std::istringstream ss(Bench::GetArchive(HugeEntries, HugeSize, Bench::DataKind::Random, true));
+	auto ar = Zip::MakeInputArchive(&ss);
+
+	ar.setCrcCheck((Zip::CrcCheck) state.range(0));
+
+	for (auto _ : state) {
+
+		for (std::size_t i = 0; i < HugeEntries; i++) {
+
+			std::size_t size = 0;
+
+			ar.entry(Bench::MakeEntryName(i)).exportTo(
+				[&size](const char*, std::size_t len)
+				{
+					size += len;
+				}
+			);
+
+			benchmark::DoNotOptimize(size);
+		}
+
+	}
+
+	state.SetBytesProcessed(state.iterations() * HugeEntries * HugeSize);
+}
+
+BENCHMARK(BM_ExportStored)
+	->ArgName("crc_check")
+	->Arg((long) Zip::CrcCheck::Default)
+	->Arg((long) Zip::CrcCheck::Verify)
+	->Arg((long) Zip::CrcCheck::Skip)
+	->Unit(benchmark::kMillisecond);
+
+static void BM_Crc32(benchmark::State& state)
+{
+	std::string data = Bench::MakeData(state.range(0), Bench::DataKind::Random);
+
+	for (auto _ : state) {
+		benchmark::DoNotOptimize(Zip::Crc32::update(0, data.data(), data.size()));
+	}
+
+	state.SetBytesProcessed(state.iterations() * state.range(0));
+	state.SetLabel(Zip::Crc32::getImplementation());
+}
+
+BENCHMARK(BM_Crc32)->Arg(256)->Arg(64 * 1024)->Arg(16 * 1024 * 1024);
+
+static void BM_ImportFrom(benchmark::State& state)
+{
+	std::vector<std::string> data;
+
+	for (std::size_t i = 0; i < (std::size_t) state.range(0); i++) {
+		data.push_back(Bench::MakeData(state.range(1), KindOf(state), (unsigned) i));
+	}
+
+	for (auto _ : state) {
+
+		std::stringstream ss;
+		auto ar = Zip::MakeOutputArchive(&ss);
+
+		for (std::size_t i = 0; i < data.size(); i++) {
+			std::istringstream is(data[i]);
+			ar.entry(Bench::MakeEntryName(i)) << is;
+		}
+
+		state.PauseTiming();
+		ar.discardAndClose();
+		state.ResumeTiming();
+	}
+
+	state.SetBytesProcessed(state.iterations() * state.range(0) * state.range(1));
+	ReportMemory(state);
+}
+
+BENCHMARK(BM_ImportFrom)->Apply(ArchiveShapes)->Unit(benchmark::kMillisecond);
+
+static void BM_SaveAndClose(benchmark::State& state)
+{
+	std::vector<std::string> data;
+
+	for (std::size_t i = 0; i < (std::size_t) state.range(0); i++) {
+		data.push_back(Bench::MakeData(state.range(1), KindOf(state), (unsigned) i));
+	}
+
+	for (auto _ : state) {
+
+		state.PauseTiming();
+
+		std::stringstream ss;
+		auto ar = Zip::MakeOutputArchive(&ss);
+
+		for (std::size_t i = 0; i < data.size(); i++) {
+			std::istringstream is(data[i]);
+			ar.entry(Bench::MakeEntryName(i)) << is;
+		}
+
+		state.ResumeTiming();
+
+		ar.saveAndClose();
+	}
+
+	state.SetBytesProcessed(state.iterations() * state.range(0) * state.range(1));
+	ReportMemory(state);
+}
+
+BENCHMARK(BM_SaveAndClose)->Apply(ArchiveShapes)->Unit(benchmark::kMillisecond);
@@ -0,0 +1,139 @@
+#pragma once
+
+#include <ZipCpp/ZipCpp.h>
+
+#include <cstdint>
+#include <map>
+#include <random>
+#include <sstream>
+#include <string>
+#include <tuple>
+
+#ifdef _WIN32
+	#ifndef NOMINMAX
+		#define NOMINMAX
+	#endif
+	#include <windows.h>
+	#include <psapi.h>
+#else
+	#include <sys/resource.h>
+#endif
+
+// Creates synthetic archives in memory for the benchmarks
+
+namespace Bench {
+
+	enum class DataKind {
+		Compressible,	// repeated text
+		Random			// incompressible bytes
+	};
+
+	inline std::string MakeData(std::size_t size, DataKind kind, unsigned seed = 1)
+	{
+		std::string data;
+
+		data.reserve(size);
+
+		if (kind == DataKind::Compressible) {
+
+			static const std::string text =
+				"The quick brown fox jumps over the lazy dog. 0123456789\n";
+
+			while (data.size() < size) {
+				data.append(text, 0, size - data.size() < text.size()
+					? size - data.size() : text.size());
+			}
+
+		}
+		else {
+
+			std::mt19937 generator(seed);
+
+			while (data.size() < size) {
+				data += (char) (generator() & 0xFF);
+			}
+
+		}
+
+		return data;
+	}
+
+	inline std::string MakeEntryName(std::size_t i)
+	{
+		return "dir" + std::to_string(i % 16) + "/entry" + std::to_string(i) + ".dat";
+	}
+
+	// returns an archive with numOfEntries entries of entrySize bytes,
+	// stored without compression if store is set, archives are cached
+	// so they are generated only once per process
+	inline const std::string& GetArchive(
+		std::size_t numOfEntries,
+		std::size_t entrySize,
+		DataKind kind,
+		bool store = false
+	)
+	{
+		typedef std::tuple<std::size_t, std::size_t, DataKind, bool> Key;
+
+		static std::map<Key, std::string> archives;
+
+		Key key(numOfEntries, entrySize, kind, store);
+
+		auto it = archives.find(key);
+
+		if (it != archives.end()) {
+			return it->second;
+		}
+
+		std::stringstream ss;
+
+		{
+			auto ar = Zip::MakeOutputArchive(&ss);
+
+			if (store) {
+				ar.setCompression(Zip::CompressionPolicy::Store());
+			}
+
+			for (std::size_t i = 0; i < numOfEntries; i++) {
+				std::istringstream is(MakeData(entrySize, kind, (unsigned) i));
+				ar.entry(MakeEntryName(i)) << is;
+			}
+
+			ar.saveAndClose();
+		}
+
+		return archives[key] = ss.str();
+	}
+
+	// returns the peak resident set size of the process in KiB
+	inline double PeakRssKiB()
+	{
+		#ifdef _WIN32
+
+			PROCESS_MEMORY_COUNTERS counters;
+
+			if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) {
+				return 0.0;
+			}
+
+			return (double) counters.PeakWorkingSetSize / 1024.0;
+
+		#else
+
+			struct rusage usage;
+
+			if (getrusage(RUSAGE_SELF, &usage) != 0) {
+				return 0.0;
+			}
+
+			#ifdef __APPLE__
+				// reported in bytes
+				return (double) usage.ru_maxrss / 1024.0;
+			#else
+				return (double) usage.ru_maxrss;
+			#endif
+
+		#endif
+	}
+
+}
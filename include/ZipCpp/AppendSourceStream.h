@@ -0,0 +1,564 @@
+#pragma once
+
+#include "WritableSourceStream.h"
+#include "NullInputStream.h"
+#include "ZipHandle.h"
+
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <unordered_set>
+
+#ifdef _WIN32
+	#include <fcntl.h>
+	#include <io.h>
+	#include <share.h>
+	#include <sys/stat.h>
+#else
+	#include <unistd.h>
+#endif
+
+namespace Zip {
+inline namespace ZIPCPP_METRICS_NAMESPACE {
+
+	// This class adds entries to an existing archive file without rewriting it.
+	// libzip sees a new empty archive and writes the added entries after
+	// the end of the file, the old central directory is then written again
+	// in front of the new one. The original contents are never overwritten,
+	// so if saving fails or is interrupted, cutting the file back to its
+	// original size restores the archive. Each append leaves a copy
+	// of the previous central directory behind as unused space.
+
+	class AppendSourceStream : public WritableSourceStream<
+		NullInputStream::SharedPtr,
+		std::shared_ptr<std::fstream>
+	> {
+	public:
+
+		typedef WritableSourceStream<
+			NullInputStream::SharedPtr,
+			std::shared_ptr<std::fstream>
+		> Base;
+
+		static zip_int64_t dispatch(
+			void *userdata,
+			void *data,
+			zip_uint64_t len,
+			zip_source_cmd_t cmd
+		)
+		{
+			return SourceDispatcher<AppendSourceStream>::dispatch(userdata, data, len, cmd);
+		}
+
+		AppendSourceStream(
+			const std::string& filePath,
+			std::size_t writeBufferSize = Base::DefaultWriteBufferSize
+		) :
+			Base(
+				std::make_shared<NullInputStream>(),
+				std::make_shared<std::fstream>(),
+				writeBufferSize
+			),
+			_filePath(filePath),
+			_fileSize(0),
+			_isModified(false)
+		{}
+
+		// returns the names of the entries in the file, an entry of the same
+		// name cannot be added, a missing file is an empty archive
+		std::unordered_set<std::string> readExistingNames()
+		{
+			std::unordered_set<std::string> names;
+
+			auto& fs = *_outputStreamPtr;
+
+			fs.clear();
+			fs.open(_filePath, std::ios::in | std::ios::binary);
+
+			if (!fs.is_open()) {
+				return names;
+			}
+
+			try {
+
+				fs.seekg(0, std::ios::end);
+				zip_uint64_t fileSize = (zip_uint64_t) (zip_int64_t) fs.tellg();
+
+				if (fileSize > 0) {
+
+					EndRecord end = readEndRecord(fileSize);
+
+					forEachName(readData(end.cdOffset, end.cdSize), [&names](std::string name)
+					{
+						names.insert(std::move(name));
+					});
+
+				}
+
+			}
+			catch (const std::exception&) {
+				fs.close();
+				throw;
+			}
+
+			fs.close();
+
+			return names;
+		}
+
+	protected:
+
+		template<typename> friend class SourceDispatcher;
+
+		virtual zip_int64_t beginWrite()
+		{
+			try {
+				openFile();
+			}
+			catch (const std::exception&) {
+				_outputStreamPtr->close();
+				_lastError.setCode(ZIP_ER_OPEN);
+				return -1;
+			}
+
+			// new entries follow the original end of the file
+			_outputStreamPtr->seekp((std::streamoff) _fileSize, std::ios::beg);
+			_isModified = true;
+
+			return Base::beginWrite();
+		}
+
+		virtual zip_int64_t commitWrite()
+		{
+			if (Base::commitWrite() < 0) {
+				restoreFile();
+				return -1;
+			}
+
+			try {
+				writeCentralDirectory();
+			}
+			catch (const std::exception&) {
+				restoreFile();
+				_lastError.setCode(ZIP_ER_WRITE);
+				return -1;
+			}
+
+			_outputStreamPtr->close();
+			_isModified = false;
+
+			return 0;
+		}
+
+		virtual zip_int64_t rollbackWrite()
+		{
+			Base::rollbackWrite();
+			restoreFile();
+			return 0;
+		}
+
+	private:
+
+		// position and size of the central directory
+		struct EndRecord {
+			zip_uint64_t cdOffset = 0;
+			zip_uint64_t cdSize = 0;
+			zip_uint64_t numOfEntries = 0;
+			std::string comment;
+		};
+
+		static const zip_uint32_t CdEntrySignature = 0x02014b50;
+		static const zip_uint32_t EndSignature = 0x06054b50;
+		static const zip_uint32_t Zip64EndSignature = 0x06064b50;
+		static const zip_uint32_t Zip64LocatorSignature = 0x07064b50;
+
+		static const std::size_t CdEntrySize = 46;
+		static const std::size_t EndSize = 22;
+		static const std::size_t Zip64EndSize = 56;
+		static const std::size_t Zip64LocatorSize = 20;
+
+		std::string _filePath;
+		zip_uint64_t _fileSize;
+		EndRecord _end;
+		// original central directory
+		std::string _centralDir;
+		bool _isModified;
+
+		void openFile()
+		{
+			auto& fs = *_outputStreamPtr;
+
+			fs.clear();
+			fs.open(_filePath, std::ios::in | std::ios::out | std::ios::binary);
+
+			if (!fs.is_open()) {
+
+				// append to an empty archive
+				std::ofstream(_filePath, std::ios::binary);
+
+				fs.clear();
+				fs.open(_filePath, std::ios::in | std::ios::out | std::ios::binary);
+
+				if (!fs.is_open()) {
+					throw std::runtime_error("cannot open archive file -> " + _filePath);
+				}
+
+			}
+
+			fs.seekg(0, std::ios::end);
+			_fileSize = (zip_uint64_t) (zip_int64_t) fs.tellg();
+
+			if (_fileSize == 0) {
+				_end = EndRecord();
+				_centralDir.clear();
+				return;
+			}
+
+			_end = readEndRecord(_fileSize);
+			_centralDir = readData(_end.cdOffset, _end.cdSize);
+		}
+
+		// reads the end records of an archive ending at the given position
+		EndRecord readEndRecord(zip_uint64_t endPos)
+		{
+			// the end record is followed by a comment of up to 64 KiB
+			zip_uint64_t searchSize = endPos < EndSize + 0xFFFF
+				? endPos : EndSize + 0xFFFF;
+
+			std::string buf = readData(endPos - searchSize, searchSize);
+
+			for (std::size_t i = buf.size() - EndSize + 1; i-- > 0; ) {
+
+				const char* p = buf.data() + i;
+
+				if (
+					get32(p) != EndSignature ||
+					i + EndSize + get16(p + 20) != buf.size()
+				) {
+					continue;
+				}
+
+				if (get16(p + 4) != 0 || get16(p + 6) != 0) {
+					throw std::runtime_error("multi-disk archives cannot be appended to");
+				}
+
+				EndRecord end;
+
+				end.numOfEntries = get16(p + 10);
+				end.cdSize = get32(p + 12);
+				end.cdOffset = get32(p + 16);
+				end.comment.assign(p + EndSize, get16(p + 20));
+
+				zip_uint64_t endRecordPos = endPos - searchSize + i;
+
+				if (endRecordPos >= Zip64LocatorSize) {
+
+					std::string locator = readData(
+						endRecordPos - Zip64LocatorSize,
+						Zip64LocatorSize
+					);
+
+					if (get32(locator.data()) == Zip64LocatorSignature) {
+
+						std::string zip64End = readData(
+							get64(locator.data() + 8),
+							Zip64EndSize
+						);
+
+						if (get32(zip64End.data()) != Zip64EndSignature) {
+							throw std::runtime_error("invalid zip64 end of central directory");
+						}
+
+						end.numOfEntries = get64(zip64End.data() + 32);
+						end.cdSize = get64(zip64End.data() + 40);
+						end.cdOffset = get64(zip64End.data() + 48);
+					}
+
+				}
+
+				if (end.cdOffset + end.cdSize > endRecordPos) {
+					throw std::runtime_error("invalid central directory");
+				}
+
+				return end;
+			}
+
+			throw std::runtime_error("not a zip archive -> " + _filePath);
+		}
+
+		// joins the old and the new central directory after the new entries
+		void writeCentralDirectory()
+		{
+			EndRecord added = readEndRecord((zip_uint64_t) _outputSize);
+			std::string addedCd = readData(added.cdOffset, added.cdSize);
+
+			checkNames(addedCd);
+
+			EndRecord end;
+
+			end.cdOffset = added.cdOffset;
+			end.cdSize = _end.cdSize + added.cdSize;
+			end.numOfEntries = _end.numOfEntries + added.numOfEntries;
+			end.comment = _end.comment;
+
+			std::string data;
+
+			data.reserve(end.cdSize + Zip64EndSize + Zip64LocatorSize + EndSize + end.comment.size());
+
+			data.append(_centralDir);
+			data.append(addedCd);
+
+			appendEndRecords(data, end);
+
+			// replaces the central directory and end records written by libzip
+			writeData(end.cdOffset, data);
+
+			zip_uint64_t newSize = end.cdOffset + data.size();
+
+			if (newSize < (zip_uint64_t) _outputSize) {
+				// readers must not find the end records of libzip after ours
+				_outputStreamPtr->close();
+				truncateFile(newSize);
+			}
+		}
+
+		// entries with the same name as an existing one are refused
+		void checkNames(const std::string& addedCd)
+		{
+			std::unordered_set<std::string> names;
+
+			forEachName(_centralDir, [&names](std::string name)
+			{
+				names.insert(std::move(name));
+			});
+
+			forEachName(addedCd, [&names](std::string name)
+			{
+				if (names.count(name) > 0) {
+					throw std::runtime_error("entry already exists -> " + name);
+				}
+			});
+		}
+
+		template<typename Func>
+		static void forEachName(const std::string& cd, Func func)
+		{
+			std::size_t pos = 0;
+
+			while (pos + CdEntrySize <= cd.size()) {
+
+				const char* p = cd.data() + pos;
+
+				if (get32(p) != CdEntrySignature) {
+					throw std::runtime_error("invalid central directory entry");
+				}
+
+				std::size_t nameLen = get16(p + 28);
+				std::size_t entrySize = CdEntrySize + nameLen + get16(p + 30) + get16(p + 32);
+
+				if (pos + entrySize > cd.size()) {
+					throw std::runtime_error("invalid central directory entry");
+				}
+
+				func(std::string(p + CdEntrySize, nameLen));
+
+				pos += entrySize;
+			}
+		}
+
+		static void appendEndRecords(std::string& data, const EndRecord& end)
+		{
+			bool isZip64 =
+				end.numOfEntries >= 0xFFFF ||
+				end.cdSize >= 0xFFFFFFFF ||
+				end.cdOffset >= 0xFFFFFFFF;
+
+			if (isZip64) {
+
+				zip_uint64_t zip64EndPos = end.cdOffset + end.cdSize;
+
+				put32(data, Zip64EndSignature);
+				put64(data, Zip64EndSize - 12);
+				put16(data, 45);	// version made by
+				put16(data, 45);	// version needed to extract
+				put32(data, 0);		// number of this disk
+				put32(data, 0);		// disk with the central directory
+				put64(data, end.numOfEntries);
+				put64(data, end.numOfEntries);
+				put64(data, end.cdSize);
+				put64(data, end.cdOffset);
+
+				put32(data, Zip64LocatorSignature);
+				put32(data, 0);		// disk with the zip64 end record
+				put64(data, zip64EndPos);
+				put32(data, 1);		// total number of disks
+			}
+
+			zip_uint16_t numOfEntries = end.numOfEntries >= 0xFFFF
+				? 0xFFFF : (zip_uint16_t) end.numOfEntries;
+
+			put32(data, EndSignature);
+			put16(data, 0);
+			put16(data, 0);
+			put16(data, numOfEntries);
+			put16(data, numOfEntries);
+			put32(data, end.cdSize >= 0xFFFFFFFF ? 0xFFFFFFFF : (zip_uint32_t) end.cdSize);
+			put32(data, end.cdOffset >= 0xFFFFFFFF ? 0xFFFFFFFF : (zip_uint32_t) end.cdOffset);
+			put16(data, (zip_uint16_t) end.comment.size());
+			data.append(end.comment);
+		}
+
+		// cuts off everything written after the original end of the file
+		void restoreFile()
+		{
+			if (!_isModified) {
+				return;
+			}
+
+			_isModified = false;
+			_outputStreamPtr->close();
+
+			try {
+				truncateFile(_fileSize);
+			}
+			catch (const std::exception&) {
+			}
+		}
+
+		std::string readData(zip_uint64_t offset, zip_uint64_t len)
+		{
+			auto& fs = *_outputStreamPtr;
+
+			std::string data((std::size_t) len, '\0');
+
+			fs.seekg((std::streamoff) offset, std::ios::beg);
+			fs.read(&data[0], (std::streamsize) len);
+
+			if (fs.fail()) {
+				throw std::runtime_error("cannot read archive file -> " + _filePath);
+			}
+
+			return data;
+		}
+
+		void writeData(zip_uint64_t offset, const std::string& data)
+		{
+			auto& fs = *_outputStreamPtr;
+
+			fs.seekp((std::streamoff) offset, std::ios::beg);
+			fs.write(data.data(), (std::streamsize) data.size());
+			fs.flush();
+
+			if (fs.fail()) {
+				throw std::runtime_error("cannot write archive file -> " + _filePath);
+			}
+		}
+
+		void truncateFile(zip_uint64_t size)
+		{
+			#ifdef _WIN32
+
+				int fd = -1;
+
+				if (_sopen_s(&fd, _filePath.c_str(), _O_RDWR | _O_BINARY, _SH_DENYNO, _S_IREAD | _S_IWRITE) != 0) {
+					throw std::runtime_error("cannot truncate archive file -> " + _filePath);
+				}
+
+				int result = _chsize_s(fd, (__int64) size);
+				_close(fd);
+
+			#else
+
+				int result = ::truncate(_filePath.c_str(), (off_t) size);
+
+			#endif
+
+			if (result != 0) {
+				throw std::runtime_error("cannot truncate archive file -> " + _filePath);
+			}
+		}
+
+		static zip_uint16_t get16(const char* p)
+		{
+			const unsigned char* u = reinterpret_cast<const unsigned char*>(p);
+			return (zip_uint16_t) (u[0] | (u[1] << 8));
+		}
+
+		static zip_uint32_t get32(const char* p)
+		{
+			return (zip_uint32_t) get16(p) | ((zip_uint32_t) get16(p + 2) << 16);
+		}
+
+		static zip_uint64_t get64(const char* p)
+		{
+			return (zip_uint64_t) get32(p) | ((zip_uint64_t) get32(p + 4) << 32);
+		}
+
+		static void put16(std::string& data, zip_uint16_t value)
+		{
+			data += (char) (value & 0xFF);
+			data += (char) (value >> 8);
+		}
+
+		static void put32(std::string& data, zip_uint32_t value)
+		{
+			put16(data, (zip_uint16_t) (value & 0xFFFF));
+			put16(data, (zip_uint16_t) (value >> 16));
+		}
+
+		static void put64(std::string& data, zip_uint64_t value)
+		{
+			put32(data, (zip_uint32_t) (value & 0xFFFFFFFF));
+			put32(data, (zip_uint32_t) (value >> 32));
+		}
+
+	};
+
+	// Opens a zip archive handle that adds entries to the end of an archive file.
+	inline ZipHandle::SharedPtr OpenAppendZipHandle(const std::string& filePath)
+	{
+		auto appendSource = std::make_shared<AppendSourceStream>(filePath);
+
+		Error error;
+
+		zip_source_t* zipSrcPtr = zip_source_function_create(
+			&AppendSourceStream::dispatch,
+			appendSource.get(),
+			error.getInternalStructPtr()
+		);
+
+		if (!zipSrcPtr) {
+
+			throw std::runtime_error(
+				"cannot create a zip archive source -> "
+					+ error.getErrMessage()
+			);
+
+		}
+
+		zip_t* newZipPtr = zip_open_from_source(
+			zipSrcPtr,
+			ZIP_CREATE,
+			error.getInternalStructPtr()
+		);
+
+		if (!newZipPtr) {
+
+			zip_source_free(zipSrcPtr);
+
+			throw std::runtime_error(
+				"cannot open a zip archive from the data source -> "
+					+ error.getErrMessage()
+			);
+
+		}
+
+		auto handle = std::make_shared<ZipHandle>(newZipPtr, appendSource);
+
+		handle->setReservedNames(appendSource->readExistingNames());
+
+		return handle;
+	}
+
+}
+}
@@ -8,8 +8,11 @@
 #include "Error.h"
 #include "ZipHandle.h"
 #include "ArchiveEntry.h"
+#include "EntryTable.h"
+#include "Extractor.h"
 
 namespace Zip {
+inline namespace ZIPCPP_METRICS_NAMESPACE {
 
 	class Archive {
 	public:
@@ -21,41 +24,163 @@ namespace Zip {
 		typedef struct zip_stat EntryInfo;
 		typedef std::vector<EntryInfo> EntryList;
 
+		typedef std::function<bool(const EntryInfo&)> EntryFilter;
+
 		Archive() :
-			_openFunc(nullptr)
+			_openFunc(nullptr),
+			_entryBufferLimit(SpoolStream::Unlimited),
+			_copyBufferSize(ArchiveEntry::DefaultCopyBufferSize),
+			_crcCheck(CrcCheck::Default)
 		{}
 
 		Archive(OpenFunc openFunc) :
-			_openFunc(openFunc)
+			_openFunc(openFunc),
+			_entryBufferLimit(SpoolStream::Unlimited),
+			_copyBufferSize(ArchiveEntry::DefaultCopyBufferSize),
+			_crcCheck(CrcCheck::Default)
 		{}
 
+		// Sets how many bytes of an entry opened for writing are kept
+		// in memory until saving, the rest is spooled to a temporary file.
+		void setEntryBufferLimit(std::size_t limit)
+		{
+			_entryBufferLimit = limit;
+		}
+
+		std::size_t getEntryBufferLimit() const
+		{
+			return _entryBufferLimit;
+		}
+
+		// Sets the size of the buffer used by exportTo and importFrom.
+		void setCopyBufferSize(std::size_t size)
+		{
+			_copyBufferSize = size > 0 ? size : ArchiveEntry::DefaultCopyBufferSize;
+		}
+
+		std::size_t getCopyBufferSize() const
+		{
+			return _copyBufferSize;
+		}
+
+		// Sets how entries opened afterwards are checked against their crc,
+		// Verify checks stored entries with the hardware accelerated Crc32
+		// and Skip reads them unchecked from trusted archives.
+		void setCrcCheck(CrcCheck crcCheck)
+		{
+			_crcCheck = crcCheck;
+		}
+
+		CrcCheck getCrcCheck() const
+		{
+			return _crcCheck;
+		}
+
+		// Sets what decodes compressed entries opened afterwards instead of
+		// libzip, e.g. InflateIndex::makeFactory() lets entry streams seek
+		// in deflated entries through checkpoints. Their crc is checked
+		// unless the crc check is Skip.
+		void setEntryDecoder(EntryDecoder::Factory factory)
+		{
+			_decoderFactory = factory;
+		}
+
+		EntryDecoder::Factory getEntryDecoder() const
+		{
+			return _decoderFactory;
+		}
+
+		// Sets where the wrapper allocates entry streams, entry handles and
+		// their bookkeeping for this archive, e.g. a MonotonicArena released
+		// at once when the archive and its streams are gone. It is best set
+		// right after the archive is created, it cannot be changed while
+		// entries are open. The archive and the entry streams opened from it
+		// keep the resource alive, so the streams may outlive the archive.
+		void setMemoryResource(MemoryResource::SharedPtr resource)
+		{
+			if (_handle) {
+				_handle->setMemoryResource(resource);
+			}
+
+			_resource = resource;
+		}
+
+		MemoryResource::SharedPtr getMemoryResource()
+		{
+			if (_handle) {
+				return _handle->getMemoryResource();
+			}
+
+			return _resource ? _resource : MemoryResource::getDefault();
+		}
+
 		EntryList getEntryList()
 		{
 			EntryList entryList;
 
-			zip_int64_t numOfEntries = zip_get_num_entries(
-				getHandle()->get(),
-				0
+			entryList.reserve(getNumOfEntries());
+
+			forEachEntry(
+				[&entryList](const EntryInfo& stat)
+				{
+					entryList.push_back(stat);
+				}
+			);
+
+			return entryList;
+		}
+
+		// Returns information about all entries stored column by column.
+		EntryTable getEntryTable()
+		{
+			EntryTable entryTable;
+
+			entryTable.reserve(getNumOfEntries());
+
+			forEachEntry(
+				[&entryTable](const EntryInfo& stat)
+				{
+					entryTable.append(stat);
+				}
 			);
 
+			return entryTable;
+		}
+
+		// Calls func(const EntryInfo&) for each entry without building a list.
+		template<typename Func>
+		void forEachEntry(Func func)
+		{
+			zip_t* zipPtr = getHandle()->get();
+
+			zip_int64_t numOfEntries = zip_get_num_entries(zipPtr, 0);
+
 			for (zip_int64_t index = 0; index < numOfEntries; index++) {
 
 				struct zip_stat stat;
 
 				int result = zip_stat_index(
-					getHandle()->get(),
+					zipPtr,
 					index,
 					0,
 					&stat
 				);
 
 				if (result == 0) {
-					entryList.push_back(stat);
+					func(stat);
 				}
 
 			}
+		}
 
-			return entryList;
+		std::size_t getNumOfEntries()
+		{
+			zip_int64_t numOfEntries = zip_get_num_entries(
+				getHandle()->get(),
+				0
+			);
+
+			return numOfEntries > 0 ? (std::size_t) numOfEntries : 0;
 		}
 
 		ArchiveEntry entry(
@@ -65,105 +190,130 @@ namespace Zip {
 		)
 		{
 			// get a file index for the given name
-			zip_int64_t entryIndex = zip_name_locate(
-				getHandle()->get(),
-				entryPath.c_str(),
+			zip_int64_t entryIndex = getHandle()->locateEntry(
+				entryPath,
 				flags
 			);
 
-			auto weakHandle = getWeakHandle();
+			return makeEntry(entryIndex, entryPath, entryPwd);
+		}
 
-			return ArchiveEntry (
+		// Returns the entry at the given index without looking up its name.
+		ArchiveEntry entryAt(
+			zip_uint64_t entryIndex,
+			const std::string& entryPwd = ""
+		)
+		{
+			const char* entryPath = zip_get_name(
+				getHandle()->get(),
 				entryIndex,
-				// open for reading
-				[weakHandle, entryPwd] (zip_int64_t entryIndex)
-				{
-					auto tempHandle = weakHandle.lock();
-					
-					if (!tempHandle) {
-						throw std::logic_error("archive has been destroyed");
-					}
-
-					ZipFileHandle::SharedPtr fileHandle;
+				ZIP_FL_ENC_GUESS
+			);
 
-					if (entryPwd.empty()) {
+			if (!entryPath) {
+				return makeEntry(-1, "", entryPwd);
+			}
 
-						fileHandle = tempHandle->openEntry(
-							entryIndex
-						);
-						
-					}
-					else {
+			return makeEntry((zip_int64_t) entryIndex, entryPath, entryPwd);
+		}
 
-						fileHandle = tempHandle->openEncryptedEntry(
-							entryIndex,
-							entryPwd
-						);
-						
-					}
+		// Opens the entry at the given index for plain sequential reading,
+		// unlike entry() nothing is allocated besides libzip's own state.
+		EntryReader openEntryReader(
+			zip_uint64_t entryIndex,
+			const std::string& entryPwd = ""
+		)
+		{
+			return getHandle()->openEntryReader(entryIndex, entryPwd);
+		}
 
-					auto entryStream = std::make_shared<
-						ReadableEntryStream
-					>(
-						fileHandle,
-						// deleter
-						[weakHandle] (
-							ZipFileHandle::WeakPtr fileHandle
-						)
-						{
-							auto tempHandle = weakHandle.lock();
+		// Reads the whole entry at the given index into the buffer, its capacity
+		// is reused when reading more entries. Returns the size of the entry.
+		std::size_t readEntry(
+			zip_uint64_t entryIndex,
+			std::vector<char>& buffer,
+			const std::string& entryPwd = ""
+		)
+		{
+			ZipHandle& handle = *getHandle();
 
-							if (!tempHandle) {
-								return;
-							}
+			struct zip_stat stat;
 
-							auto tempFileHandle = fileHandle.lock();
+			if (zip_stat_index(handle.get(), entryIndex, 0, &stat) != 0) {
+				throw std::logic_error("archive file entry not found");
+			}
 
-							if (tempFileHandle) {
-								tempHandle->closeEntry(tempFileHandle->get());
-							}
-						}
-					);
+			EntryReader reader = handle.openEntryReader(entryIndex, entryPwd);
 
-					return entryStream;
-				},
+			buffer.resize((stat.valid & ZIP_STAT_SIZE) ? (std::size_t) stat.size : 0);
 
-				// open for writing
-				[weakHandle, entryPath, entryPwd] (zip_int64_t entryIndex)
-				{
-					auto tempHandle = weakHandle.lock();
-					
-					if (!tempHandle) {
-						throw std::logic_error("archive has been destroyed");
-					}
+			std::size_t size = 0;
 
-					auto ss = std::make_shared<std::stringstream>();
+			while (size < buffer.size()) {
 
-					if (entryPwd.empty()) {
-						tempHandle->addEntry(entryPath, ss);
-					}
-					else {
-						tempHandle->addEncryptedEntry(entryPath, entryPwd, ss);
-					}
+				std::size_t nread = reader.read(buffer.data() + size, buffer.size() - size);
 
-					return std::make_shared<
-						WritableEntryStream
-					>(weakHandle, ss);
+				if (nread == 0) {
+					break;
 				}
-			);
 
+				size += nread;
+
+			}
+
+			buffer.resize(size);
+
+			return size;
+		}
+
+		// Extracts all entries into the directory one by one, see ConcurrentArchive
+		// for extraction on more threads. Returns a result for each entry.
+		ExtractResultList extractAll(
+			const std::string& destDir,
+			const ExtractOptions& options = ExtractOptions()
+		)
+		{
+			Extractor extractor(destDir, getEntryList(), options);
+
+			for (std::size_t i = 0; i < extractor.getNumOfTasks(); i++) {
+				extractor.extract(i, *this);
+			}
+
+			return extractor.takeResults();
+		}
+
+		// Sets the compression policy for entries added afterwards.
+		void setCompression(const CompressionPolicy& compression)
+		{
+			getHandle()->setDefaultCompression(compression);
+		}
+
+		template<typename InputStream>
+		void addEntry(
+			const std::string& entryPath,
+			InputStream readableStream,
+			int flags = 0
+		)
+		{
+			getHandle()->addEntry(
+				entryPath,
+				readableStream,
+				flags
+			);
 		}
 
 		template<typename InputStream>
 		void addEntry(
 			const std::string& entryPath,
 			InputStream readableStream,
+			const CompressionPolicy& compression,
 			int flags = 0
 		)
 		{
 			getHandle()->addEntry(
 				entryPath,
 				readableStream,
+				compression,
 				flags
 			);
 		}
@@ -176,7 +326,7 @@ namespace Zip {
 			int flags = 0
 		)
 		{
-			return getHandle()->addEncryptedEntry(
+			getHandle()->addEncryptedEntry(
 				entryPath,
 				entryPwd,
 				readableStream,
@@ -184,6 +334,80 @@ namespace Zip {
 			);
 		}
 
+		template<typename InputStream>
+		void addEncryptedEntry(
+			const std::string& entryPath,
+			const std::string& entryPwd,
+			InputStream readableStream,
+			const CompressionPolicy& compression,
+			int flags = 0
+		)
+		{
+			getHandle()->addEncryptedEntry(
+				entryPath,
+				entryPwd,
+				readableStream,
+				compression,
+				flags
+			);
+		}
+
+		// Adds an entry of the source archive under the same or a new name,
+		// its compressed data is copied without being decompressed and compressed
+		// again. The source archive is kept open until this archive is closed.
+		void copyEntryFrom(
+			Archive& sourceArchive,
+			const std::string& entryPath,
+			const std::string& newEntryPath = "",
+			int flags = ZIP_FL_NOCASE | ZIP_FL_ENC_GUESS
+		)
+		{
+			auto sourceHandle = sourceArchive.getHandle();
+
+			zip_int64_t sourceIndex = sourceHandle->locateEntry(
+				entryPath,
+				flags
+			);
+
+			if (sourceIndex < 0) {
+				throw std::logic_error("archive file entry not found");
+			}
+
+			getHandle()->copyEntryFrom(
+				sourceHandle,
+				sourceIndex,
+				newEntryPath.empty() ? entryPath : newEntryPath
+			);
+		}
+
+		// Copies the entries of the source archive accepted by the filter
+		// (all when it is empty) the same way as copyEntryFrom.
+		// Returns the number of copied entries.
+		std::size_t mergeFrom(
+			Archive& sourceArchive,
+			EntryFilter filter = nullptr
+		)
+		{
+			auto sourceHandle = sourceArchive.getHandle();
+			auto handle = getHandle();
+
+			std::size_t numOfCopied = 0;
+
+			sourceArchive.forEachEntry(
+				[&](const EntryInfo& stat)
+				{
+					if (filter && !filter(stat)) {
+						return;
+					}
+
+					handle->copyEntryFrom(sourceHandle, stat.index, stat.name);
+					numOfCopied++;
+				}
+			);
+
+			return numOfCopied;
+		}
+
 		void discardAndClose()
 		{
 			getHandle()->discardAndClose();
@@ -194,17 +418,42 @@ namespace Zip {
 			getHandle()->saveAndClose();
 		}
 
+		// Lets the preprocessor (e.g. ParallelCompressor) work on the pending
+		// changes first, then saves changes and closes the archive.
+		template<typename Preprocessor>
+		void saveAndClose(Preprocessor preprocess)
+		{
+			auto handle = getHandle();
+
+			if (handle->isOpen()) {
+				preprocess(*handle);
+			}
+
+			handle->saveAndClose();
+		}
+
 	private:
 
 		OpenFunc _openFunc;
 		ZipHandle::SharedPtr _handle;
+		std::size_t _entryBufferLimit;
+		std::size_t _copyBufferSize;
+		CrcCheck _crcCheck;
+		EntryDecoder::Factory _decoderFactory;
+		MemoryResource::SharedPtr _resource;
 
 		ZipHandle::SharedPtr getHandle()
 		{
 			if (!_handle) {
+
 				_handle = _openFunc();
 				// release the function after use
 				_openFunc = nullptr;
+
+				if (_resource) {
+					_handle->setMemoryResource(_resource);
+				}
+
 			}
 
 			return _handle;
@@ -215,6 +464,181 @@ namespace Zip {
 			return getHandle();
 		}
 
+		ArchiveEntry makeEntry(
+			zip_int64_t entryIndex,
+			const std::string& entryPath,
+			const std::string& entryPwd
+		)
+		{
+			auto weakHandle = getWeakHandle();
+			auto bufferLimit = _entryBufferLimit;
+			auto crcCheck = _crcCheck;
+			auto decoderFactory = _decoderFactory;
+
+			return ArchiveEntry (
+				entryIndex,
+				// open for reading
+				[weakHandle, entryPwd, crcCheck, decoderFactory] (zip_int64_t entryIndex)
+				{
+					auto tempHandle = weakHandle.lock();
+					
+					if (!tempHandle) {
+						throw std::logic_error("archive has been destroyed");
+					}
+
+					struct zip_stat stat;
+
+					if (zip_stat_index(tempHandle->get(), entryIndex, 0, &stat) != 0) {
+						zip_stat_init(&stat);
+					}
+
+					zip_int64_t size = (stat.valid & ZIP_STAT_SIZE)
+						? (zip_int64_t) stat.size : -1;
+
+					// data of stored entries can be seeked without decompression
+					bool isSeekable =
+						(stat.valid & ZIP_STAT_COMP_METHOD) &&
+						(stat.valid & ZIP_STAT_ENCRYPTION_METHOD) &&
+						stat.comp_method == ZIP_CM_STORE &&
+						stat.encryption_method == ZIP_EM_NONE;
+
+					EntryDecoder::SharedPtr decoder;
+
+					if (
+						decoderFactory &&
+						!isSeekable &&
+						entryPwd.empty() &&
+						(stat.valid & ZIP_STAT_ENCRYPTION_METHOD) &&
+						stat.encryption_method == ZIP_EM_NONE
+					) {
+						decoder = decoderFactory(stat);
+					}
+
+					// stored entries are read as they are unless libzip checks them
+					bool isRaw = decoder || (
+						crcCheck != CrcCheck::Default &&
+						isSeekable &&
+						size > 0 &&
+						entryPwd.empty()
+					);
+
+					// libzip does not check decoded entries either
+					bool checkCrc = decoder
+						? crcCheck != CrcCheck::Skip
+						: isRaw && crcCheck == CrcCheck::Verify;
+
+					zip_int64_t expectedCrc =
+						checkCrc && (stat.valid & ZIP_STAT_CRC)
+							? (zip_int64_t) stat.crc : -1;
+
+					// opens the entry, also used to rewind it when seeking back
+					auto openFile = [weakHandle, entryPwd, entryIndex, isRaw, size] ()
+					{
+						auto tempHandle = weakHandle.lock();
+
+						if (!tempHandle) {
+							throw std::logic_error("archive has been destroyed");
+						}
+
+						ZipFileHandle::SharedPtr fileHandle;
+
+						if (isRaw) {
+
+							fileHandle = tempHandle->openRawEntry(
+								entryIndex
+							);
+
+						}
+						else if (entryPwd.empty()) {
+
+							fileHandle = tempHandle->openEntry(
+								entryIndex
+							);
+
+						}
+						else {
+
+							fileHandle = tempHandle->openEncryptedEntry(
+								entryIndex,
+								entryPwd
+							);
+
+						}
+
+						return ZipFileHandle::WeakPtr(fileHandle);
+					};
+
+					auto entryStream = std::allocate_shared<
+						ReadableEntryStream
+					>(
+						tempHandle->getOwningAllocator(),
+						openFile(),
+						// deleter
+						[weakHandle] (
+							ZipFileHandle::WeakPtr fileHandle
+						)
+						{
+							auto tempHandle = weakHandle.lock();
+
+							if (!tempHandle) {
+								return;
+							}
+
+							auto tempFileHandle = fileHandle.lock();
+
+							if (tempFileHandle) {
+								tempHandle->closeEntry(tempFileHandle.get());
+							}
+						},
+						openFile,
+						size,
+						isSeekable,
+						expectedCrc,
+						decoder
+					);
+
+					return entryStream;
+				},
+
+				// open for writing
+				[weakHandle, entryPath, entryPwd, bufferLimit] (
+					zip_int64_t entryIndex,
+					const CompressionPolicy* compression
+				)
+				{
+					auto tempHandle = weakHandle.lock();
+					
+					if (!tempHandle) {
+						throw std::logic_error("archive has been destroyed");
+					}
+
+					auto ss = std::allocate_shared<SpoolStream>(
+						tempHandle->getOwningAllocator(),
+						bufferLimit
+					);
+
+					if (!compression) {
+						compression = &tempHandle->getDefaultCompression();
+					}
+
+					if (entryPwd.empty()) {
+						tempHandle->addEntry(entryPath, ss, *compression);
+					}
+					else {
+						tempHandle->addEncryptedEntry(entryPath, entryPwd, ss, *compression);
+					}
+
+					return std::allocate_shared<
+						WritableEntryStream
+					>(tempHandle->getOwningAllocator(), weakHandle, ss);
+				},
+
+				_copyBufferSize
+			);
+
+		}
+
 	};
 
+}
 }
\ No newline at end of file
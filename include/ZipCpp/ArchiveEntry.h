@@ -5,8 +5,11 @@
 
 #include "ReadableEntryStream.h"
 #include "WritableEntryStream.h"
+#include "CompressionPolicy.h"
+#include "BufferPool.h"
 
 namespace Zip {
+inline namespace ZIPCPP_METRICS_NAMESPACE {
 
 	class ArchiveEntry {
 	public:
@@ -16,17 +19,25 @@ namespace Zip {
 		> OpenForReading;
 
 		typedef std::function<
-			WritableEntryStream::SharedPtr(zip_int64_t)
+			WritableEntryStream::SharedPtr(
+				zip_int64_t,
+				const CompressionPolicy*
+			)
 		> OpenForWriting;
 
+		static const std::size_t DefaultCopyBufferSize = 256 * 1024;
+
 		ArchiveEntry(
 			zip_int64_t entryIndex,
 			OpenForReading openForReading,
-			OpenForWriting openForWriting
+			OpenForWriting openForWriting,
+			std::size_t copyBufferSize = DefaultCopyBufferSize
 		) :
 			_entryIndex(entryIndex),
 			_openForReading(openForReading),
-			_openForWriting(openForWriting)
+			_openForWriting(openForWriting),
+			_hasCompression(false),
+			_copyBufferSize(copyBufferSize)
 		{}
 
 		zip_int64_t getIndex()
@@ -55,19 +66,57 @@ namespace Zip {
 
 		WritableEntryStream::SharedPtr openForWriting()
 		{
-			return _openForWriting(_entryIndex);
+			return _openForWriting(
+				_entryIndex,
+				_hasCompression ? &_compression : nullptr
+			);
+		}
+
+		// overrides the archive compression policy for data written to the entry
+		ArchiveEntry& setCompression(const CompressionPolicy& compression)
+		{
+			_compression = compression;
+			_hasCompression = true;
+
+			return *this;
 		}
 
 		template<typename T>
-		void exportTo(T& os)
+		auto exportTo(T& os)
+			-> decltype(os.write((const char*) nullptr, 0), void())
 		{
-			copyStream(openForReading(), &os);
+			copyStream(openForReading(), &os, _copyBufferSize);
+		}
+
+		// passes the data to sink(const char* data, std::size_t len) chunk by chunk
+		template<typename Sink>
+		auto exportTo(Sink sink)
+			-> decltype(sink((const char*) nullptr, (std::size_t) 0), void())
+		{
+			auto is = openForReading();
+			auto buf = BufferPool::acquire(_copyBufferSize);
+
+			do {
+
+				is->read(buf.data(), buf.size());
+
+				if (is->fail()) {
+					throw std::runtime_error(
+						"failed to read data from input stream"
+					);
+				}
+
+				if (is->gcount() > 0) {
+					sink((const char*) buf.data(), (std::size_t) is->gcount());
+				}
+
+			} while (!is->eof());
 		}
 
 		template<typename T>
 		void importFrom(T& is)
 		{
-			copyStream(&is, openForWriting());
+			copyStream(&is, openForWriting(), _copyBufferSize);
 		}
 
 		template<typename T>
@@ -89,11 +138,14 @@ namespace Zip {
 		zip_int64_t _entryIndex;
 		OpenForReading _openForReading;
 		OpenForWriting _openForWriting;
+		CompressionPolicy _compression;
+		bool _hasCompression;
+		std::size_t _copyBufferSize;
 
 		template<typename IStream, typename OStream>
-		static void copyStream(IStream is, OStream os)
+		static void copyStream(IStream is, OStream os, std::size_t bufferSize)
 		{
-			std::vector<char> buf(4096);
+			auto buf = BufferPool::acquire(bufferSize);
 
 			if (!is->good()) {
 				throw std::logic_error("input stream is not ready for reading");
@@ -130,4 +182,5 @@ namespace Zip {
 
 	};
 
+}
 }
\ No newline at end of file
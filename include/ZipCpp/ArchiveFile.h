@@ -1,8 +1,10 @@
 #pragma once
 
 #include "Archive.h"
+#include "AppendSourceStream.h"
 
 namespace Zip {
+inline namespace ZIPCPP_METRICS_NAMESPACE {
 
 	class ArchiveFile : public Archive {
 	public:
@@ -11,7 +13,8 @@ namespace Zip {
 			Existing,	// open an existing archive
 			Create,		// create archive if it does not exist
 			ReadOnly,	// open archive only for reading
-			Truncate	// if archive exists, ignores its current contents
+			Truncate,	// if archive exists, ignores its current contents
+			Append		// only adds entries after the existing ones, which are not listed
 		};
 
 		ArchiveFile(const std::string& filePath, Mode mode = Mode::Create) :
@@ -21,6 +24,11 @@ namespace Zip {
 					int flags;
 					int zipErrCode;
 
+					if (mode == Mode::Append) {
+						// saving does not copy the existing entries
+						return OpenAppendZipHandle(filePath);
+					}
+
 					switch (mode) {
 
 						case Mode::Existing: flags = 0; break;
@@ -54,4 +62,5 @@ namespace Zip {
 
 	};
 
+}
 }
\ No newline at end of file
@@ -4,20 +4,29 @@
 #include "WritableSourceStream.h"
 
 namespace Zip {
+inline namespace ZIPCPP_METRICS_NAMESPACE {
 
-	// Creates an instance of input/output archive stream.
+	// Creates an instance of input/output archive stream, data written by libzip
+	// are passed to the output stream in blocks of writeBufferSize bytes.
 	template<typename InputStream, typename OutputStream>
-	Archive MakeArchive(InputStream inputStream, OutputStream outputStream)
+	Archive MakeArchive(
+		InputStream inputStream,
+		OutputStream outputStream,
+		std::size_t writeBufferSize = WritableSourceStream<
+			InputStream,
+			OutputStream
+		>::DefaultWriteBufferSize
+	)
 	{
 		return Archive(
-			[inputStream, outputStream]()
+			[inputStream, outputStream, writeBufferSize]()
 			{
 				auto writableSource = std::make_shared<
 					WritableSourceStream<
 						InputStream,
 						OutputStream
 					>
-				>(inputStream, outputStream);
+				>(inputStream, outputStream, writeBufferSize);
 
 				Error error;
 
@@ -65,12 +74,17 @@ namespace Zip {
 	template<typename InputStream, typename OutputStream>
 	Archive::SharedPtr MakeSharedArchive(
 		InputStream inputStream,
-		OutputStream outputStream
+		OutputStream outputStream,
+		std::size_t writeBufferSize = WritableSourceStream<
+			InputStream,
+			OutputStream
+		>::DefaultWriteBufferSize
 	)
 	{
 		return std::make_shared<Archive>(
-			MakeArchive(inputStream, outputStream)
+			MakeArchive(inputStream, outputStream, writeBufferSize)
 		);
 	}
 
+}
 }
\ No newline at end of file
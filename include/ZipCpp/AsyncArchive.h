@@ -0,0 +1,254 @@
+#pragma once
+
+#include "Archive.h"
+#include "ThreadPool.h"
+
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+
+namespace Zip {
+inline namespace ZIPCPP_METRICS_NAMESPACE {
+
+	// This class runs archive operations on a thread pool and reports
+	// their completion through callbacks, so a caller such as an event loop
+	// never blocks on decompression or I/O. Operations of one archive run
+	// one at a time in the order they were started, operations of different
+	// archives sharing the pool run in parallel. Callbacks are invoked
+	// on a pool thread, exceptions thrown by them are ignored. The archive
+	// does not own the pool, it has to outlive the archive and the streams
+	// opened from it.
+
+	class AsyncArchive {
+	public:
+
+		typedef std::shared_ptr<AsyncArchive> SharedPtr;
+
+		typedef std::function<void(std::exception_ptr)> CompletionHandler;
+
+		typedef std::function<
+			void(std::exception_ptr, ReadableEntryStream::SharedPtr)
+		> OpenHandler;
+
+		typedef std::function<void(std::exception_ptr, std::size_t)> ReadHandler;
+
+		AsyncArchive(Archive::SharedPtr archive, ThreadPool& threadPool) :
+			_state(std::make_shared<State>(archive, threadPool))
+		{}
+
+		// calls func(Archive&) on the pool, then handler(error)
+		template<typename Func>
+		void post(Func func, CompletionHandler handler)
+		{
+			auto archive = _state->archive;
+
+			enqueue(_state, [archive, func, handler]()
+			{
+				std::exception_ptr error;
+
+				try {
+					func(*archive);
+				}
+				catch (...) {
+					error = std::current_exception();
+				}
+
+				handler(error);
+			});
+		}
+
+		// opens an entry for reading, the stream passed to the handler
+		// can be released on any thread, it is closed on the pool
+		void asyncOpenForReading(
+			const std::string& entryPath,
+			OpenHandler handler,
+			const std::string& entryPwd = ""
+		)
+		{
+			auto state = _state;
+
+			enqueue(state, [state, entryPath, entryPwd, handler]()
+			{
+				ReadableEntryStream::SharedPtr stream;
+				std::exception_ptr error;
+
+				try {
+
+					auto entryStream = state->archive->entry(
+						entryPath,
+						entryPwd
+					).openForReading();
+
+					stream = ReadableEntryStream::SharedPtr(
+						entryStream.get(),
+						[state, entryStream](ReadableEntryStream*) mutable
+						{
+							// closing the entry touches the archive
+							enqueue(state, [entryStream]() {});
+							entryStream.reset();
+						}
+					);
+
+				}
+				catch (...) {
+					error = std::current_exception();
+				}
+
+				handler(error, stream);
+			});
+		}
+
+		// reads up to len bytes from a stream opened by asyncOpenForReading,
+		// the buffer must stay valid until the handler is called,
+		// zero bytes read means the end of the entry
+		void asyncRead(
+			ReadableEntryStream::SharedPtr stream,
+			char* buf,
+			std::size_t len,
+			ReadHandler handler
+		)
+		{
+			enqueue(_state, [stream, buf, len, handler]()
+			{
+				try {
+					stream->read(buf, len);
+				}
+				catch (...) {
+					handler(std::current_exception(), 0);
+					return;
+				}
+
+				if (stream->fail()) {
+
+					handler(
+						std::make_exception_ptr(std::runtime_error(
+							"failed to read data from archive entry"
+						)),
+						0
+					);
+
+					return;
+				}
+
+				handler(nullptr, stream->gcount());
+			});
+		}
+
+		// passes the entry data to sink(const char* data, std::size_t len)
+		// on the pool, then calls handler(error)
+		template<typename Sink>
+		void asyncExportTo(
+			const std::string& entryPath,
+			Sink sink,
+			CompletionHandler handler,
+			const std::string& entryPwd = ""
+		)
+		{
+			post(
+				[entryPath, entryPwd, sink](Archive& archive)
+				{
+					archive.entry(entryPath, entryPwd).exportTo(sink);
+				},
+				handler
+			);
+		}
+
+		// compresses the entries and writes the archive on the pool
+		void asyncSaveAndClose(CompletionHandler handler)
+		{
+			post(
+				[](Archive& archive)
+				{
+					archive.saveAndClose();
+				},
+				handler
+			);
+		}
+
+	private:
+
+		typedef std::function<void()> Task;
+
+		struct State {
+
+			State(Archive::SharedPtr archive, ThreadPool& threadPool) :
+				archive(archive),
+				threadPool(threadPool),
+				isRunning(false)
+			{}
+
+			Archive::SharedPtr archive;
+			// not owned, the last reference to the pool could be released
+			// on one of its own threads otherwise, which cannot join itself
+			ThreadPool& threadPool;
+			std::deque<Task> tasks;
+			std::mutex mutex;
+			bool isRunning;
+
+		};
+
+		std::shared_ptr<State> _state;
+
+		static void enqueue(std::shared_ptr<State> state, Task task)
+		{
+			{
+				std::lock_guard<std::mutex> lock(state->mutex);
+
+				state->tasks.push_back(std::move(task));
+
+				if (state->isRunning) {
+					// the running task schedules the next one
+					return;
+				}
+
+				state->isRunning = true;
+			}
+
+			schedule(state);
+		}
+
+		// runs the next task on the pool, the state lives until the queue is empty
+		static void schedule(std::shared_ptr<State> state)
+		{
+			state->threadPool.post([state]()
+			{
+				Task task;
+
+				{
+					std::lock_guard<std::mutex> lock(state->mutex);
+					task = std::move(state->tasks.front());
+					state->tasks.pop_front();
+				}
+
+				try {
+					task();
+				}
+				catch (...) {
+					// a throwing callback must not stop the queue
+				}
+
+				// captured objects are destroyed before the next task starts
+				task = nullptr;
+
+				{
+					std::lock_guard<std::mutex> lock(state->mutex);
+
+					if (state->tasks.empty()) {
+						state->isRunning = false;
+						return;
+					}
+				}
+
+				// give tasks of other archives a chance to run
+				schedule(state);
+			});
+		}
+
+	};
+
+}
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+
+// This class recycles copy buffers per thread, so repeated copies
+// do not allocate and initialize a new buffer each time
+
+namespace Zip {
+
+	class BufferPool {
+	public:
+
+		typedef std::vector<char> Buffer;
+
+		// maximum number of idle buffers kept by a thread
+		static const std::size_t MaxIdleBuffers = 4;
+
+		// gives a buffer back to the pool when destroyed
+		class Lease {
+		public:
+
+			Lease(std::unique_ptr<Buffer> buffer) :
+				_buffer(std::move(buffer))
+			{}
+
+			Lease(Lease&& other) = default;
+			Lease& operator= (Lease&& other) = default;
+
+			~Lease()
+			{
+				if (_buffer) {
+					release(std::move(_buffer));
+				}
+			}
+
+			char* data() { return _buffer->data(); }
+			std::size_t size() const { return _buffer->size(); }
+
+		private:
+
+			std::unique_ptr<Buffer> _buffer;
+
+		};
+
+		// returns a buffer of the given size owned by the calling thread
+		static Lease acquire(std::size_t size)
+		{
+			auto& idle = idleBuffers();
+
+			std::unique_ptr<Buffer> buffer;
+
+			if (!idle.empty()) {
+				buffer = std::move(idle.back());
+				idle.pop_back();
+			}
+			else {
+				buffer.reset(new Buffer());
+			}
+
+			// keeps the capacity when the buffer is reused for a smaller size
+			buffer->resize(size);
+
+			return Lease(std::move(buffer));
+		}
+
+	private:
+
+		static std::vector<std::unique_ptr<Buffer>>& idleBuffers()
+		{
+			thread_local std::vector<std::unique_ptr<Buffer>> buffers;
+			return buffers;
+		}
+
+		static void release(std::unique_ptr<Buffer> buffer)
+		{
+			auto& idle = idleBuffers();
+
+			if (idle.size() < MaxIdleBuffers) {
+				idle.push_back(std::move(buffer));
+			}
+		}
+
+	};
+
+}
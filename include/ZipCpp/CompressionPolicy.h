@@ -0,0 +1,159 @@
+#pragma once
+
+#include <zipconf.h>
+#include <zip.h>
+
+#include <cmath>
+#include <cstring>
+
+namespace Zip {
+
+	// This class describes how archive entries are compressed: a libzip method
+	// (ZIP_CM_*) with a level, or an automatic choice between storing
+	// and compressing based on a sample from the beginning of each entry.
+
+	class CompressionPolicy {
+	public:
+
+		static const std::size_t DefaultSampleSize = 64 * 1024;
+
+		// bits per byte above which a sample is considered incompressible
+		static constexpr double DefaultMaxEntropy = 7.5;
+
+		// level 0 means the default level of the method
+		CompressionPolicy(zip_int32_t method = ZIP_CM_DEFAULT, zip_uint32_t level = 0) :
+			_method(method),
+			_level(level),
+			_isAuto(false),
+			_sampleSize(DefaultSampleSize),
+			_maxEntropy(DefaultMaxEntropy)
+		{}
+
+		// stores entries without compression
+		static CompressionPolicy Store()
+		{
+			return CompressionPolicy(ZIP_CM_STORE);
+		}
+
+		// stores entries whose sample looks incompressible,
+		// the rest is compressed with the given method and level
+		static CompressionPolicy Auto(
+			zip_int32_t method = ZIP_CM_DEFAULT,
+			zip_uint32_t level = 0,
+			std::size_t sampleSize = DefaultSampleSize,
+			double maxEntropy = DefaultMaxEntropy
+		)
+		{
+			CompressionPolicy policy(method, level);
+
+			policy._isAuto = true;
+			policy._sampleSize = sampleSize;
+			policy._maxEntropy = maxEntropy;
+
+			return policy;
+		}
+
+		zip_int32_t getMethod() const { return _method; }
+		zip_uint32_t getLevel() const { return _level; }
+		bool isAuto() const { return _isAuto; }
+		std::size_t getSampleSize() const { return _sampleSize; }
+
+		// returns true if the policy leaves everything to libzip defaults
+		bool isDefault() const
+		{
+			return !_isAuto && _method == ZIP_CM_DEFAULT && _level == 0;
+		}
+
+		// returns the fixed policy selected for an entry starting with the sample
+		CompressionPolicy choose(const char* sample, std::size_t len) const
+		{
+			if (!_isAuto) {
+				return *this;
+			}
+
+			if (isCompressedFormat(sample, len) || entropy(sample, len) > _maxEntropy) {
+				return Store();
+			}
+
+			return CompressionPolicy(_method, _level);
+		}
+
+		// computes Shannon entropy of the data in bits per byte
+		static double entropy(const char* data, std::size_t len)
+		{
+			if (len == 0) {
+				return 0.0;
+			}
+
+			std::size_t counts[256] = {};
+
+			for (std::size_t i = 0; i < len; i++) {
+				counts[(unsigned char) data[i]]++;
+			}
+
+			double result = 0.0;
+
+			for (std::size_t count : counts) {
+
+				if (count > 0) {
+					double p = (double) count / (double) len;
+					result -= p * std::log2(p);
+				}
+
+			}
+
+			return result;
+		}
+
+		// detects signatures of common already-compressed formats
+		static bool isCompressedFormat(const char* data, std::size_t len)
+		{
+			struct Signature {
+				std::size_t offset;
+				const char* bytes;
+				std::size_t len;
+			};
+
+			static const Signature signatures[] = {
+				{ 0, "\xFF\xD8\xFF", 3 },				// JPEG
+				{ 0, "\x89PNG", 4 },					// PNG
+				{ 0, "GIF8", 4 },						// GIF
+				{ 4, "ftyp", 4 },						// MP4, MOV, HEIC
+				{ 0, "\x1A\x45\xDF\xA3", 4 },			// Matroska, WebM
+				{ 0, "PK\x03\x04", 4 },					// ZIP, JAR, OOXML
+				{ 0, "\x1F\x8B", 2 },					// gzip
+				{ 0, "BZh", 3 },						// bzip2
+				{ 0, "\xFD" "7zXZ", 5 },				// xz
+				{ 0, "\x28\xB5\x2F\xFD", 4 },			// zstd
+				{ 0, "7z\xBC\xAF", 4 },					// 7-Zip
+				{ 0, "Rar!", 4 },						// RAR
+				{ 0, "ID3", 3 },						// MP3
+				{ 0, "OggS", 4 },						// Ogg
+				{ 0, "fLaC", 4 }						// FLAC
+			};
+
+			for (const Signature& signature : signatures) {
+
+				if (
+					len >= signature.offset + signature.len &&
+					std::memcmp(data + signature.offset, signature.bytes, signature.len) == 0
+				) {
+					return true;
+				}
+
+			}
+
+			return false;
+		}
+
+	private:
+
+		zip_int32_t _method;
+		zip_uint32_t _level;
+		bool _isAuto;
+		std::size_t _sampleSize;
+		double _maxEntropy;
+
+	};
+
+}
@@ -0,0 +1,277 @@
+#pragma once
+
+#include "ArchiveFile.h"
+#include "InputArchiveStream.h"
+#include "MappedInputArchive.h"
+#include "ThreadPool.h"
+
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace Zip {
+inline namespace ZIPCPP_METRICS_NAMESPACE {
+
+	// This class keeps archive instances created by a factory,
+	// they are lent to one thread at a time and returned for reuse.
+
+	class ArchivePool {
+	public:
+
+		typedef std::function<Archive()> ArchiveFactory;
+
+		// zero maxArchives means one instance per hardware core
+		ArchivePool(ArchiveFactory factory, unsigned maxArchives) :
+			_factory(factory),
+			_maxArchives(maxArchives),
+			_numOfArchives(0)
+		{
+			if (_maxArchives == 0) {
+				_maxArchives = std::thread::hardware_concurrency();
+			}
+
+			if (_maxArchives == 0) {
+				_maxArchives = 1;
+			}
+		}
+
+		std::unique_ptr<Archive> acquire()
+		{
+			std::unique_lock<std::mutex> lock(_mutex);
+
+			_archiveReleased.wait(lock, [this]() {
+				return !_idleArchives.empty() || _numOfArchives < _maxArchives;
+			});
+
+			if (!_idleArchives.empty()) {
+				auto archive = std::move(_idleArchives.back());
+				_idleArchives.pop_back();
+				return archive;
+			}
+
+			_numOfArchives++;
+			lock.unlock();
+
+			try {
+
+				std::unique_ptr<Archive> archive(new Archive(_factory()));
+
+				// open the archive now, so that parsing of the central directory
+				// does not happen later under the lock of somebody else
+				archive->getNumOfEntries();
+
+				return archive;
+			}
+			catch (...) {
+
+				lock.lock();
+				_numOfArchives--;
+				lock.unlock();
+
+				_archiveReleased.notify_one();
+
+				throw;
+			}
+		}
+
+		void release(std::unique_ptr<Archive> archive)
+		{
+			{
+				std::lock_guard<std::mutex> lock(_mutex);
+				_idleArchives.push_back(std::move(archive));
+			}
+
+			_archiveReleased.notify_one();
+		}
+
+	private:
+
+		ArchiveFactory _factory;
+		unsigned _maxArchives;
+		unsigned _numOfArchives;
+		std::vector<std::unique_ptr<Archive>> _idleArchives;
+		std::mutex _mutex;
+		std::condition_variable _archiveReleased;
+
+	};
+
+	// This class lets many threads read one archive at the same time.
+	// A libzip handle must not be used by more threads at once, so the class
+	// keeps a pool of independent archive instances over the same data,
+	// created on demand by a factory, and lends them to readers.
+
+	class ConcurrentArchive {
+	public:
+
+		typedef std::shared_ptr<ConcurrentArchive> SharedPtr;
+		typedef ArchivePool::ArchiveFactory ArchiveFactory;
+
+		// borrowed archive instance, returned to the pool when destroyed
+		class Lease {
+		public:
+
+			Lease(Lease&& other) = default;
+			Lease& operator= (Lease&& other) = default;
+
+			~Lease()
+			{
+				if (_archive) {
+					_pool->release(std::move(_archive));
+				}
+			}
+
+			Archive& archive() { return *_archive; }
+			Archive* operator-> () { return _archive.get(); }
+
+		private:
+
+			friend class ConcurrentArchive;
+
+			std::shared_ptr<ArchivePool> _pool;
+			std::unique_ptr<Archive> _archive;
+
+			Lease(std::shared_ptr<ArchivePool> pool, std::unique_ptr<Archive> archive) :
+				_pool(pool),
+				_archive(std::move(archive))
+			{}
+
+		};
+
+		// maxArchives limits the number of open instances,
+		// zero means one instance per hardware core
+		ConcurrentArchive(ArchiveFactory factory, unsigned maxArchives = 0) :
+			_pool(std::make_shared<ArchivePool>(factory, maxArchives))
+		{}
+
+		// borrows an archive instance, waits if all of them are in use
+		Lease acquire()
+		{
+			return Lease(_pool, _pool->acquire());
+		}
+
+		// opens an entry for reading, the archive instance is borrowed
+		// until the returned stream is destroyed
+		ReadableEntryStream::SharedPtr openForReading(
+			const std::string& entryPath,
+			const std::string& entryPwd = "",
+			int flags = ZIP_FL_NOCASE | ZIP_FL_ENC_GUESS
+		)
+		{
+			struct Holder {
+				// the stream must be closed before the lease is returned
+				Lease lease;
+				ReadableEntryStream::SharedPtr stream;
+			};
+
+			auto holder = std::make_shared<Holder>(Holder { acquire(), nullptr });
+
+			holder->stream = holder->lease->entry(
+				entryPath,
+				entryPwd,
+				flags
+			).openForReading();
+
+			return ReadableEntryStream::SharedPtr(holder, holder->stream.get());
+		}
+
+		template<typename T>
+		void exportTo(
+			const std::string& entryPath,
+			T&& os,
+			const std::string& entryPwd = ""
+		)
+		{
+			auto lease = acquire();
+			lease->entry(entryPath, entryPwd).exportTo(os);
+		}
+
+		Archive::EntryList getEntryList()
+		{
+			return acquire()->getEntryList();
+		}
+
+		// Extracts all entries into the directory on a pool of threads,
+		// each of them reads through its own archive instance.
+		// Returns a result for each entry.
+		ExtractResultList extractAll(
+			const std::string& destDir,
+			const ExtractOptions& options = ExtractOptions()
+		)
+		{
+			Extractor extractor(destDir, getEntryList(), options);
+
+			ThreadPool threadPool(options.numOfThreads);
+
+			threadPool.forEach(
+				extractor.getNumOfTasks(),
+				[this, &extractor](std::size_t task)
+				{
+					auto lease = acquire();
+					extractor.extract(task, lease.archive());
+				}
+			);
+
+			return extractor.takeResults();
+		}
+
+	private:
+
+		std::shared_ptr<ArchivePool> _pool;
+
+	};
+
+	// Creates an archive file that can be read by many threads at once.
+	inline ConcurrentArchive MakeConcurrentArchiveFile(
+		const std::string& filePath,
+		unsigned maxArchives = 0
+	)
+	{
+		return ConcurrentArchive(
+			[filePath]()
+			{
+				return ArchiveFile(filePath, ArchiveFile::Mode::ReadOnly);
+			},
+			maxArchives
+		);
+	}
+
+	// Creates a memory-mapped archive that can be read by many threads at once,
+	// all instances share one mapping of the file.
+	inline ConcurrentArchive MakeConcurrentMappedInputArchive(
+		const std::string& filePath,
+		unsigned maxArchives = 0
+	)
+	{
+		auto mappedFile = std::make_shared<MappedFile>(filePath);
+
+		return ConcurrentArchive(
+			[mappedFile]()
+			{
+				return MakeMappedInputArchive(mappedFile);
+			},
+			maxArchives
+		);
+	}
+
+	// Creates an input archive that can be read by many threads at once,
+	// streamFactory has to return a new independent input stream on each call.
+	template<typename StreamFactory>
+	ConcurrentArchive MakeConcurrentInputArchive(
+		StreamFactory streamFactory,
+		unsigned maxArchives = 0
+	)
+	{
+		return ConcurrentArchive(
+			[streamFactory]()
+			{
+				return MakeInputArchive(streamFactory());
+			},
+			maxArchives
+		);
+	}
+
+}
+}
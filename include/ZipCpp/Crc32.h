@@ -0,0 +1,328 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+// CRC-32 as used by zip and zlib with a kernel chosen at run time:
+// carry-less multiplication (PCLMULQDQ) on x86 processors that support it,
+// the CRC32 instructions on ARMv8 when the compiler targets them,
+// and slicing-by-8 tables everywhere else.
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+
+	#define ZIPCPP_CRC32_X86
+
+	#ifdef _MSC_VER
+		#include <intrin.h>
+		#define ZIPCPP_CRC32_TARGET
+	#else
+		#include <cpuid.h>
+		#define ZIPCPP_CRC32_TARGET __attribute__((target("pclmul,sse4.1")))
+	#endif
+
+	#include <emmintrin.h>
+	#include <smmintrin.h>
+	#include <wmmintrin.h>
+
+#elif defined(__aarch64__) && defined(__ARM_FEATURE_CRC32)
+
+	#define ZIPCPP_CRC32_ARM
+
+	#include <arm_acle.h>
+
+#endif
+
+namespace Zip {
+
+	class Crc32 {
+	public:
+
+		// continues the crc over the data, the crc of no data is 0
+		static std::uint32_t update(std::uint32_t crc, const void* data, std::size_t len)
+		{
+			const unsigned char* buf = reinterpret_cast<const unsigned char*>(data);
+
+			crc = ~crc;
+
+			#if defined(ZIPCPP_CRC32_X86)
+
+				if (len >= 64 && hasPclmul()) {
+
+					// the kernel works on whole 16-byte chunks
+					std::size_t chunkSize = len & ~(std::size_t) 15;
+
+					crc = foldPclmul(buf, chunkSize, crc);
+
+					buf += chunkSize;
+					len -= chunkSize;
+
+				}
+
+			#elif defined(ZIPCPP_CRC32_ARM)
+
+				while (len >= 8) {
+
+					std::uint64_t value;
+					std::memcpy(&value, buf, 8);
+
+					crc = __crc32d(crc, value);
+
+					buf += 8;
+					len -= 8;
+
+				}
+
+				while (len > 0) {
+					crc = __crc32b(crc, *buf++);
+					len--;
+				}
+
+			#endif
+
+			return ~updateTables(crc, buf, len);
+		}
+
+		// returns the name of the kernel used on this machine
+		static const char* getImplementation()
+		{
+			#if defined(ZIPCPP_CRC32_X86)
+				return hasPclmul() ? "pclmul" : "slicing-by-8";
+			#elif defined(ZIPCPP_CRC32_ARM)
+				return "armv8-crc";
+			#else
+				return "slicing-by-8";
+			#endif
+		}
+
+	private:
+
+		struct Tables {
+			std::uint32_t values[8][256];
+		};
+
+		static const Tables& tables()
+		{
+			static const Tables instance = makeTables();
+			return instance;
+		}
+
+		static Tables makeTables()
+		{
+			Tables tables;
+
+			for (std::uint32_t n = 0; n < 256; n++) {
+
+				std::uint32_t c = n;
+
+				for (int k = 0; k < 8; k++) {
+					c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+				}
+
+				tables.values[0][n] = c;
+
+			}
+
+			for (std::uint32_t n = 0; n < 256; n++) {
+
+				std::uint32_t c = tables.values[0][n];
+
+				for (int k = 1; k < 8; k++) {
+					c = tables.values[0][c & 0xFF] ^ (c >> 8);
+					tables.values[k][n] = c;
+				}
+
+			}
+
+			return tables;
+		}
+
+		// works on the inverted crc
+		static std::uint32_t updateTables(std::uint32_t crc, const unsigned char* buf, std::size_t len)
+		{
+			const auto& t = tables().values;
+
+			while (len >= 8) {
+
+				std::uint32_t a = crc ^ (
+					(std::uint32_t) buf[0] |
+					(std::uint32_t) buf[1] << 8 |
+					(std::uint32_t) buf[2] << 16 |
+					(std::uint32_t) buf[3] << 24
+				);
+
+				crc =
+					t[7][a & 0xFF] ^
+					t[6][(a >> 8) & 0xFF] ^
+					t[5][(a >> 16) & 0xFF] ^
+					t[4][a >> 24] ^
+					t[3][buf[4]] ^
+					t[2][buf[5]] ^
+					t[1][buf[6]] ^
+					t[0][buf[7]];
+
+				buf += 8;
+				len -= 8;
+
+			}
+
+			while (len > 0) {
+				crc = t[0][(crc ^ *buf++) & 0xFF] ^ (crc >> 8);
+				len--;
+			}
+
+			return crc;
+		}
+
+		#if defined(ZIPCPP_CRC32_X86)
+
+			static bool hasPclmul()
+			{
+				static const bool supported = detectPclmul();
+				return supported;
+			}
+
+			static bool detectPclmul()
+			{
+				unsigned int ecx = 0;
+
+				#ifdef _MSC_VER
+					int info[4];
+					__cpuid(info, 1);
+					ecx = (unsigned int) info[2];
+				#else
+					unsigned int eax, ebx, edx;
+
+					if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx)) {
+						return false;
+					}
+				#endif
+
+				// PCLMULQDQ and SSE4.1
+				return (ecx & (1u << 1)) && (ecx & (1u << 19));
+			}
+
+			// Folds 16-byte chunks with carry-less multiplication and reduces
+			// the result, see "Fast CRC Computation for Generic Polynomials Using
+			// PCLMULQDQ Instruction" by Intel; len is at least 64 and a multiple of 16,
+			// works on the inverted crc.
+			ZIPCPP_CRC32_TARGET
+			static std::uint32_t foldPclmul(const unsigned char* buf, std::size_t len, std::uint32_t crc)
+			{
+				// constants of the bit-reflected domain given at the end of the paper
+				const __m128i k1k2 = _mm_set_epi64x(0x01c6e41596, 0x0154442bd4);
+				const __m128i k3k4 = _mm_set_epi64x(0x00ccaa009e, 0x01751997d0);
+				const __m128i k5k0 = _mm_set_epi64x(0x0000000000, 0x0163cd6124);
+				const __m128i poly = _mm_set_epi64x(0x01f7011641, 0x01db710641);
+
+				__m128i x0, x1, x2, x3, x4, x5, x6, x7, x8;
+
+				x1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(buf + 0x00));
+				x2 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(buf + 0x10));
+				x3 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(buf + 0x20));
+				x4 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(buf + 0x30));
+
+				x1 = _mm_xor_si128(x1, _mm_cvtsi32_si128((int) crc));
+
+				x0 = k1k2;
+
+				buf += 64;
+				len -= 64;
+
+				// fold 64 bytes at once
+				while (len >= 64) {
+
+					x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+					x6 = _mm_clmulepi64_si128(x2, x0, 0x00);
+					x7 = _mm_clmulepi64_si128(x3, x0, 0x00);
+					x8 = _mm_clmulepi64_si128(x4, x0, 0x00);
+
+					x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+					x2 = _mm_clmulepi64_si128(x2, x0, 0x11);
+					x3 = _mm_clmulepi64_si128(x3, x0, 0x11);
+					x4 = _mm_clmulepi64_si128(x4, x0, 0x11);
+
+					x1 = _mm_xor_si128(_mm_xor_si128(x1, x5),
+						_mm_loadu_si128(reinterpret_cast<const __m128i*>(buf + 0x00)));
+					x2 = _mm_xor_si128(_mm_xor_si128(x2, x6),
+						_mm_loadu_si128(reinterpret_cast<const __m128i*>(buf + 0x10)));
+					x3 = _mm_xor_si128(_mm_xor_si128(x3, x7),
+						_mm_loadu_si128(reinterpret_cast<const __m128i*>(buf + 0x20)));
+					x4 = _mm_xor_si128(_mm_xor_si128(x4, x8),
+						_mm_loadu_si128(reinterpret_cast<const __m128i*>(buf + 0x30)));
+
+					buf += 64;
+					len -= 64;
+
+				}
+
+				// fold into 128 bits
+				x0 = k3k4;
+
+				x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+				x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+				x1 = _mm_xor_si128(_mm_xor_si128(x1, x2), x5);
+
+				x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+				x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+				x1 = _mm_xor_si128(_mm_xor_si128(x1, x3), x5);
+
+				x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+				x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+				x1 = _mm_xor_si128(_mm_xor_si128(x1, x4), x5);
+
+				// fold the remaining 16-byte chunks
+				while (len >= 16) {
+
+					x2 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(buf));
+
+					x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+					x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+					x1 = _mm_xor_si128(_mm_xor_si128(x1, x2), x5);
+
+					buf += 16;
+					len -= 16;
+
+				}
+
+				// fold 128 bits to 64 bits
+				x2 = _mm_clmulepi64_si128(x1, x0, 0x10);
+				x3 = _mm_setr_epi32(~0, 0, ~0, 0);
+				x1 = _mm_srli_si128(x1, 8);
+				x1 = _mm_xor_si128(x1, x2);
+
+				x0 = k5k0;
+
+				x2 = _mm_srli_si128(x1, 4);
+				x1 = _mm_and_si128(x1, x3);
+				x1 = _mm_clmulepi64_si128(x1, x0, 0x00);
+				x1 = _mm_xor_si128(x1, x2);
+
+				// Barrett reduction to 32 bits
+				x0 = poly;
+
+				x2 = _mm_and_si128(x1, x3);
+				x2 = _mm_clmulepi64_si128(x2, x0, 0x10);
+				x2 = _mm_and_si128(x2, x3);
+				x2 = _mm_clmulepi64_si128(x2, x0, 0x00);
+				x1 = _mm_xor_si128(x1, x2);
+
+				return (std::uint32_t) _mm_extract_epi32(x1, 1);
+			}
+
+		#endif
+
+	};
+
+	// how the data of entries is checked against the crc stored in the archive
+	enum class CrcCheck {
+		// libzip checks entries that are read as a whole
+		Default,
+		// stored entries are checked with Crc32 while reading,
+		// compressed and encrypted entries are checked by libzip
+		Verify,
+		// stored entries are not checked at all, only for trusted archives
+		Skip
+	};
+
+}
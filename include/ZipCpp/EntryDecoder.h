@@ -0,0 +1,38 @@
+#pragma once
+
+#include "ZipFileHandle.h"
+
+#include <functional>
+#include <memory>
+
+namespace Zip {
+
+	// Decodes the raw data of an entry in place of libzip, so an entry stream
+	// can seek in compressed data without starting over (see InflateIndex).
+	// The decoder reads the data through the file handle it is given,
+	// libzip checks neither the data nor its crc.
+
+	class EntryDecoder {
+	public:
+
+		typedef std::shared_ptr<EntryDecoder> SharedPtr;
+
+		// returns a decoder for the entry or nullptr to let libzip decode it
+		typedef std::function<SharedPtr(const struct zip_stat&)> Factory;
+
+		virtual ~EntryDecoder() {}
+
+		// decodes up to nbytes at the current position,
+		// returns the number of bytes, 0 at the end or -1 on failure
+		virtual zip_int64_t read(
+			ZipFileHandle& fileHandle,
+			char* buf,
+			zip_uint64_t nbytes
+		) = 0;
+
+		// moves to the position in the decoded data, returns false on failure
+		virtual bool seek(ZipFileHandle& fileHandle, zip_uint64_t pos) = 0;
+
+	};
+
+}
@@ -0,0 +1,140 @@
+#pragma once
+
+#include <zipconf.h>
+#include <zip.h>
+
+#include <string>
+#include <unordered_map>
+
+namespace Zip {
+
+	// This class maps entry names to entry indexes for O(1) lookups.
+	// It mirrors zip_name_locate: names are obtained with the same encoding flags,
+	// case-insensitive matching folds ASCII letters like strcasecmp does,
+	// and when a name occurs more than once, the lowest index wins.
+
+	class EntryNameIndex {
+	public:
+
+		EntryNameIndex() :
+			_isBuilt(false),
+			_encodingFlags(0)
+		{}
+
+		// returns true if a lookup with the given flags can be answered by the index
+		static bool canLookup(int flags)
+		{
+			return (flags & ~(ZIP_FL_NOCASE | EncodingFlags)) == 0;
+		}
+
+		bool isBuilt(int flags) const
+		{
+			return _isBuilt && _encodingFlags == (flags & EncodingFlags);
+		}
+
+		void build(zip_t* zipPtr, int flags)
+		{
+			invalidate();
+
+			zip_int64_t numOfEntries = zip_get_num_entries(zipPtr, 0);
+
+			_exactNames.reserve((std::size_t) numOfEntries);
+			_foldedNames.reserve((std::size_t) numOfEntries);
+
+			_encodingFlags = flags & EncodingFlags;
+
+			for (zip_int64_t index = 0; index < numOfEntries; index++) {
+
+				const char* name = zip_get_name(
+					zipPtr,
+					index,
+					_encodingFlags
+				);
+
+				if (name) {
+					insert(name, index);
+				}
+
+			}
+
+			_isBuilt = true;
+		}
+
+		void invalidate()
+		{
+			_exactNames.clear();
+			_foldedNames.clear();
+			_isBuilt = false;
+		}
+
+		// updates the index with an entry that has been added to the archive
+		void add(const std::string& name, zip_int64_t index)
+		{
+			if (!_isBuilt) {
+				return;
+			}
+
+			for (unsigned char c : name) {
+
+				if (c >= 0x80) {
+					// libzip may convert non-ASCII names,
+					// so let the index be rebuilt on the next lookup
+					invalidate();
+					return;
+				}
+
+			}
+
+			insert(name, index);
+		}
+
+		// returns the index of the entry or -1 if it does not exist
+		zip_int64_t find(const std::string& name, int flags) const
+		{
+			const Map& names = (flags & ZIP_FL_NOCASE) ? _foldedNames : _exactNames;
+
+			auto it = names.find(
+				(flags & ZIP_FL_NOCASE) ? fold(name) : name
+			);
+
+			if (it == names.end()) {
+				return -1;
+			}
+
+			return it->second;
+		}
+
+	private:
+
+		static const int EncodingFlags = ZIP_FL_ENC_RAW | ZIP_FL_ENC_STRICT;
+
+		typedef std::unordered_map<std::string, zip_int64_t> Map;
+
+		bool _isBuilt;
+		int _encodingFlags;
+		Map _exactNames;
+		Map _foldedNames;
+
+		void insert(const std::string& name, zip_int64_t index)
+		{
+			// emplace keeps an existing mapping, i.e. the lowest index
+			_exactNames.emplace(name, index);
+			_foldedNames.emplace(fold(name), index);
+		}
+
+		static std::string fold(std::string name)
+		{
+			for (char& c : name) {
+
+				if (c >= 'A' && c <= 'Z') {
+					c = (char) (c - 'A' + 'a');
+				}
+
+			}
+
+			return name;
+		}
+
+	};
+
+}
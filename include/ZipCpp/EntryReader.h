@@ -0,0 +1,103 @@
+#pragma once
+
+#include "Metrics.h"
+
+#include <zipconf.h>
+#include <zip.h>
+
+#include <stdexcept>
+#include <string>
+
+namespace Zip {
+inline namespace ZIPCPP_METRICS_NAMESPACE {
+
+	// This class reads an open archive entry without any bookkeeping,
+	// it owns the libzip file and closes it when destroyed. The reader is not
+	// tracked by the archive, so it has to be destroyed before the archive
+	// is closed.
+
+	class EntryReader {
+	public:
+
+		EntryReader() :
+			_zipFilePtr(nullptr)
+		{}
+
+		explicit EntryReader(zip_file_t* zipFilePtr) :
+			_zipFilePtr(zipFilePtr)
+		{}
+
+		EntryReader(EntryReader&& other) noexcept :
+			_zipFilePtr(other._zipFilePtr)
+		{
+			other._zipFilePtr = nullptr;
+		}
+
+		EntryReader& operator= (EntryReader&& other) noexcept
+		{
+			if (this != &other) {
+				close();
+				_zipFilePtr = other._zipFilePtr;
+				other._zipFilePtr = nullptr;
+			}
+
+			return *this;
+		}
+
+		EntryReader(const EntryReader&) = delete;
+		EntryReader& operator= (const EntryReader&) = delete;
+
+		~EntryReader()
+		{
+			close();
+		}
+
+		bool isOpen() const
+		{
+			return _zipFilePtr != nullptr;
+		}
+
+		explicit operator bool() const
+		{
+			return isOpen();
+		}
+
+		// reads up to len bytes, returns 0 at the end of the entry
+		std::size_t read(char* buff, std::size_t len)
+		{
+			if (!_zipFilePtr) {
+				throw std::logic_error("archive entry is not open");
+			}
+
+			zip_int64_t nread = zip_fread(_zipFilePtr, buff, len);
+
+			if (nread < 0) {
+
+				throw std::runtime_error(
+					std::string("failed to read data from archive entry -> ")
+						+ zip_file_strerror(_zipFilePtr)
+				);
+
+			}
+
+			Metrics::addCount(MetricId::EntryReadBytes, (std::uint64_t) nread);
+
+			return (std::size_t) nread;
+		}
+
+		void close()
+		{
+			if (_zipFilePtr) {
+				zip_fclose(_zipFilePtr);
+				_zipFilePtr = nullptr;
+			}
+		}
+
+	private:
+
+		zip_file_t* _zipFilePtr;
+
+	};
+
+}
+}
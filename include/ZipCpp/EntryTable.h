@@ -0,0 +1,83 @@
+#pragma once
+
+#include <zipconf.h>
+#include <zip.h>
+
+#include <cstring>
+#include <ctime>
+#include <string>
+#include <vector>
+
+namespace Zip {
+
+	// This class stores information about archive entries column by column,
+	// all names are kept in a single arena of null-terminated strings.
+
+	class EntryTable {
+	public:
+
+		// average name length used to pre-size the name arena
+		static const std::size_t ExpectedNameLength = 48;
+
+		EntryTable()
+		{}
+
+		// prepares space for the given number of entries
+		void reserve(std::size_t numOfEntries)
+		{
+			_nameOffsets.reserve(numOfEntries);
+			_indexes.reserve(numOfEntries);
+			_sizes.reserve(numOfEntries);
+			_compSizes.reserve(numOfEntries);
+			_crcs.reserve(numOfEntries);
+			_mtimes.reserve(numOfEntries);
+			_compMethods.reserve(numOfEntries);
+			_names.reserve(numOfEntries * ExpectedNameLength);
+		}
+
+		void append(const zip_stat_t& stat)
+		{
+			const char* name = (stat.valid & ZIP_STAT_NAME) && stat.name
+				? stat.name : "";
+
+			_nameOffsets.push_back(_names.size());
+			_names.append(name, std::strlen(name) + 1);
+
+			_indexes.push_back(stat.index);
+			_sizes.push_back(stat.size);
+			_compSizes.push_back(stat.comp_size);
+			_crcs.push_back(stat.crc);
+			_mtimes.push_back(stat.mtime);
+			_compMethods.push_back(stat.comp_method);
+		}
+
+		std::size_t size() const { return _indexes.size(); }
+		bool empty() const { return _indexes.empty(); }
+
+		const char* getName(std::size_t i) const { return _names.data() + _nameOffsets[i]; }
+		zip_uint64_t getIndex(std::size_t i) const { return _indexes[i]; }
+		zip_uint64_t getSize(std::size_t i) const { return _sizes[i]; }
+		zip_uint64_t getCompSize(std::size_t i) const { return _compSizes[i]; }
+		zip_uint32_t getCrc(std::size_t i) const { return _crcs[i]; }
+		time_t getMtime(std::size_t i) const { return _mtimes[i]; }
+		zip_uint16_t getCompMethod(std::size_t i) const { return _compMethods[i]; }
+
+		// whole columns for vectorized processing
+		const std::vector<zip_uint64_t>& getSizes() const { return _sizes; }
+		const std::vector<zip_uint64_t>& getCompSizes() const { return _compSizes; }
+		const std::vector<zip_uint32_t>& getCrcs() const { return _crcs; }
+
+	private:
+
+		std::string _names;
+		std::vector<std::size_t> _nameOffsets;
+		std::vector<zip_uint64_t> _indexes;
+		std::vector<zip_uint64_t> _sizes;
+		std::vector<zip_uint64_t> _compSizes;
+		std::vector<zip_uint32_t> _crcs;
+		std::vector<time_t> _mtimes;
+		std::vector<zip_uint16_t> _compMethods;
+
+	};
+
+}
@@ -0,0 +1,410 @@
+#pragma once
+
+#include <zipconf.h>
+#include <zip.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#ifdef _WIN32
+	#include <direct.h>
+#else
+	#include <fcntl.h>
+#endif
+
+namespace Zip {
+
+	struct ExtractOptions {
+
+		ExtractOptions() :
+			numOfThreads(0),
+			overwrite(true)
+		{}
+
+		// number of threads used by parallel extraction,
+		// zero means one thread per hardware core
+		unsigned numOfThreads;
+		// replaces existing files, otherwise they are reported as failures
+		bool overwrite;
+		// password of encrypted entries
+		std::string password;
+
+	};
+
+	// outcome of extracting a single entry
+	struct ExtractResult {
+
+		ExtractResult() :
+			index(0),
+			size(0),
+			success(false)
+		{}
+
+		zip_uint64_t index;
+		std::string entryPath;
+		std::string filePath;
+		zip_uint64_t size;
+		bool success;
+		std::string error;
+
+	};
+
+	typedef std::vector<ExtractResult> ExtractResultList;
+
+	// This class extracts archive entries into a directory. The constructor
+	// validates the entry names and creates all directories up front,
+	// extract() then writes one file and can be called from more threads
+	// at once for different files, each with its own archive instance.
+	// Entries with the same name make one task and are extracted in order.
+
+	class Extractor {
+	public:
+
+		typedef std::vector<struct zip_stat> EntryList;
+
+		Extractor(
+			const std::string& destDir,
+			const EntryList& entryList,
+			const ExtractOptions& options = ExtractOptions()
+		) :
+			_options(options)
+		{
+			std::string baseDir = destDir.empty() ? "." : destDir;
+
+			if (baseDir.back() != '/' && baseDir.back() != '\\') {
+				baseDir += '/';
+			}
+
+			std::set<std::string> dirs;
+			std::map<std::string, std::size_t> fileTasks;
+
+			addParentDirs(baseDir, 0, dirs);
+
+			_results.resize(entryList.size());
+
+			for (std::size_t i = 0; i < entryList.size(); i++) {
+
+				const struct zip_stat& entryStat = entryList[i];
+				ExtractResult& result = _results[i];
+
+				result.index = entryStat.index;
+				result.entryPath = (entryStat.valid & ZIP_STAT_NAME) && entryStat.name
+					? entryStat.name : "";
+				result.size = (entryStat.valid & ZIP_STAT_SIZE) ? entryStat.size : 0;
+
+				if (!isSafePath(result.entryPath)) {
+					result.error = "unsafe entry path";
+					continue;
+				}
+
+				result.filePath = baseDir + result.entryPath;
+
+				addParentDirs(result.filePath, baseDir.size(), dirs);
+
+				if (result.filePath.back() == '/') {
+					// directory entry
+					result.success = true;
+					continue;
+				}
+
+				auto it = fileTasks.find(result.filePath);
+
+				if (it != fileTasks.end()) {
+					// written after the previous entries of the same name
+					_tasks[it->second].push_back(i);
+					continue;
+				}
+
+				fileTasks[result.filePath] = _tasks.size();
+				_tasks.push_back(std::vector<std::size_t>(1, i));
+			}
+
+			// a parent sorts before its subdirectories
+			std::map<std::string, std::string> failedDirs;
+
+			for (const std::string& dir : dirs) {
+
+				std::string error = makeDir(dir);
+
+				if (!error.empty()) {
+					failedDirs[dir] = error;
+				}
+
+			}
+
+			if (!failedDirs.empty()) {
+				dropFailedEntries(failedDirs);
+			}
+
+			// start with the largest files so the work ends evenly
+			std::stable_sort(
+				_tasks.begin(),
+				_tasks.end(),
+				[this](const std::vector<std::size_t>& a, const std::vector<std::size_t>& b)
+				{
+					return _results[a.front()].size > _results[b.front()].size;
+				}
+			);
+		}
+
+		// returns the number of files to extract
+		std::size_t getNumOfTasks() const
+		{
+			return _tasks.size();
+		}
+
+		// extracts the file of the given task using archive.entryAt(),
+		// failures are recorded in the result of the entry
+		template<typename EntryArchive>
+		void extract(std::size_t task, EntryArchive& archive)
+		{
+			for (std::size_t i : _tasks[task]) {
+
+				ExtractResult& result = _results[i];
+
+				try {
+
+					extractFile(result, archive);
+					result.success = true;
+
+				}
+				catch (const std::exception& e) {
+
+					result.error = e.what();
+
+				}
+
+			}
+		}
+
+		const ExtractResultList& getResults() const
+		{
+			return _results;
+		}
+
+		ExtractResultList takeResults()
+		{
+			return std::move(_results);
+		}
+
+	private:
+
+		ExtractOptions _options;
+		ExtractResultList _results;
+		std::vector<std::vector<std::size_t>> _tasks;
+
+		// fails the entries in directories that could not be created
+		void dropFailedEntries(const std::map<std::string, std::string>& failedDirs)
+		{
+			auto findError = [&failedDirs](const std::string& path)
+			{
+				std::set<std::string> dirs;
+
+				addParentDirs(path, 0, dirs);
+
+				for (const std::string& dir : dirs) {
+
+					auto it = failedDirs.find(dir);
+
+					if (it != failedDirs.end()) {
+						return it->second;
+					}
+
+				}
+
+				return std::string();
+			};
+
+			for (ExtractResult& result : _results) {
+
+				if (result.success && result.filePath.back() == '/') {
+
+					result.error = findError(result.filePath);
+					result.success = result.error.empty();
+
+				}
+
+			}
+
+			auto failed = [this, &findError](const std::vector<std::size_t>& task)
+			{
+				std::string error = findError(_results[task.front()].filePath);
+
+				for (std::size_t i : task) {
+					_results[i].error = error;
+				}
+
+				return !error.empty();
+			};
+
+			_tasks.erase(
+				std::remove_if(_tasks.begin(), _tasks.end(), failed),
+				_tasks.end()
+			);
+		}
+
+		template<typename EntryArchive>
+		void extractFile(ExtractResult& result, EntryArchive& archive)
+		{
+			if (!_options.overwrite) {
+
+				std::FILE* existing = std::fopen(result.filePath.c_str(), "rb");
+
+				if (existing) {
+					std::fclose(existing);
+					throw std::runtime_error("file already exists");
+				}
+
+			}
+
+			std::FILE* file = std::fopen(result.filePath.c_str(), "wb");
+
+			if (!file) {
+				throw std::runtime_error(
+					std::string("cannot create file -> ") + std::strerror(errno)
+				);
+			}
+
+			// the buffer of the archive entry is large enough already
+			std::setvbuf(file, nullptr, _IONBF, 0);
+
+			#if defined(__linux__)
+
+				if (result.size > 0) {
+					// reserve the space at once to avoid fragmentation
+					::posix_fallocate(::fileno(file), 0, (off_t) result.size);
+				}
+
+			#endif
+
+			zip_uint64_t written = 0;
+
+			try {
+
+				archive.entryAt(result.index, _options.password).exportTo(
+					[file, &written](const char* data, std::size_t len)
+					{
+						if (std::fwrite(data, 1, len, file) != len) {
+							throw std::runtime_error("cannot write file");
+						}
+
+						written += len;
+					}
+				);
+
+				if (written != result.size) {
+					throw std::runtime_error("size of extracted data does not match");
+				}
+
+			}
+			catch (...) {
+				std::fclose(file);
+				// do not leave an incomplete file behind
+				std::remove(result.filePath.c_str());
+				throw;
+			}
+
+			if (std::fclose(file) != 0) {
+				std::remove(result.filePath.c_str());
+				throw std::runtime_error("cannot write file");
+			}
+		}
+
+		// rejects absolute paths and paths leading out of the directory
+		static bool isSafePath(const std::string& path)
+		{
+			if (path.empty() || path[0] == '/' || path[0] == '\\') {
+				return false;
+			}
+
+			if (path.size() >= 2 && path[1] == ':') {
+				// drive letter
+				return false;
+			}
+
+			std::size_t begin = 0;
+
+			while (begin <= path.size()) {
+
+				std::size_t end = path.find_first_of("/\\", begin);
+
+				if (end == std::string::npos) {
+					end = path.size();
+				}
+
+				if (path.compare(begin, end - begin, "..") == 0) {
+					return false;
+				}
+
+				begin = end + 1;
+			}
+
+			return true;
+		}
+
+		// adds all directories of the path after the given position
+		static void addParentDirs(
+			const std::string& path,
+			std::size_t pos,
+			std::set<std::string>& dirs
+		)
+		{
+			for (;;) {
+
+				pos = path.find_first_of("/\\", pos);
+
+				if (pos == std::string::npos) {
+					break;
+				}
+
+				pos++;
+				dirs.insert(path.substr(0, pos));
+			}
+		}
+
+		// returns the error message if the directory cannot be created
+		static std::string makeDir(const std::string& dir)
+		{
+			// a trailing slash would hide a file of the same name from stat
+			std::string path = dir.substr(0, dir.find_last_not_of("/\\") + 1);
+
+			if (path.empty() || isDir(path)) {
+				return std::string();
+			}
+
+			#ifdef _WIN32
+				int result = ::_mkdir(path.c_str());
+			#else
+				int result = ::mkdir(path.c_str(), 0777);
+			#endif
+
+			int error = errno;
+
+			if (result != 0 && (error != EEXIST || !isDir(path))) {
+				return "cannot create directory -> " + dir + ": " + std::strerror(error);
+			}
+
+			return std::string();
+		}
+
+		static bool isDir(const std::string& path)
+		{
+			struct stat pathStat;
+
+			return ::stat(path.c_str(), &pathStat) == 0
+				&& (pathStat.st_mode & S_IFMT) == S_IFDIR;
+		}
+
+	};
+
+}
@@ -0,0 +1,348 @@
+#pragma once
+
+#include "EntryDecoder.h"
+#include "BufferPool.h"
+
+#include <zlib.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+
+// This header requires zlib, so it is not included by ZipCpp.h.
+// Usage: archive.setEntryDecoder(Zip::InflateIndex::makeFactory());
+
+namespace Zip {
+
+	// Inflates a deflated entry and records a checkpoint of the inflate state
+	// at the end of a deflate block every interval bytes of output: the position
+	// in the raw data, the bits of the byte shared with the next block and
+	// the last 32 KiB of output. A seek resumes from the nearest checkpoint
+	// before the target, or reads on when that is closer, instead of inflating
+	// the entry from the beginning. Each checkpoint takes 32 KiB of memory.
+
+	class InflateIndex : public EntryDecoder {
+	public:
+
+		static const std::size_t DefaultInterval = 4 * 1024 * 1024;
+
+		// size of the deflate window, the dictionary of a checkpoint
+		static const std::size_t WindowSize = 32 * 1024;
+
+		static const std::size_t InputBufferSize = 64 * 1024;
+
+		// returns a factory of indexes for deflated entries that are not encrypted
+		static Factory makeFactory(std::size_t interval = DefaultInterval)
+		{
+			return [interval](const struct zip_stat& stat) -> EntryDecoder::SharedPtr
+			{
+				bool isDeflated =
+					(stat.valid & ZIP_STAT_COMP_METHOD) &&
+					(stat.valid & ZIP_STAT_ENCRYPTION_METHOD) &&
+					stat.comp_method == ZIP_CM_DEFLATE &&
+					stat.encryption_method == ZIP_EM_NONE;
+
+				if (!isDeflated) {
+					return nullptr;
+				}
+
+				return std::make_shared<InflateIndex>(interval);
+			};
+		}
+
+		InflateIndex(std::size_t interval = DefaultInterval) :
+			_interval(std::max(interval, std::size_t(WindowSize))),
+			_zs(z_stream()),
+			_input(InputBufferSize),
+			_inputPos(0),
+			_window(WindowSize),
+			_windowPos(0),
+			_windowFill(0),
+			_pos(0),
+			_isAtEnd(false),
+			_isValid(true)
+		{
+			if (inflateInit2(&_zs, -MAX_WBITS) != Z_OK) {
+				throw std::runtime_error("cannot initialize inflate stream");
+			}
+		}
+
+		~InflateIndex()
+		{
+			inflateEnd(&_zs);
+		}
+
+		InflateIndex(const InflateIndex&) = delete;
+		InflateIndex& operator= (const InflateIndex&) = delete;
+
+		zip_int64_t read(
+			ZipFileHandle& fileHandle,
+			char* buf,
+			zip_uint64_t nbytes
+		) override
+		{
+			if (!_isValid) {
+				return -1;
+			}
+
+			zip_uint64_t total = 0;
+
+			while (total < nbytes && !_isAtEnd) {
+
+				if (_zs.avail_in == 0) {
+
+					zip_int64_t nread = fileHandle.read(_input.data(), _input.size());
+
+					if (nread < 0) {
+						return -1;
+					}
+
+					_zs.next_in = _input.data();
+					_zs.avail_in = (uInt) nread;
+					_inputPos += (zip_uint64_t) nread;
+				}
+
+				// the output goes through the window, the dictionary of checkpoints
+				zip_uint64_t len = std::min<zip_uint64_t>(
+					WindowSize - _windowPos,
+					nbytes - total
+				);
+
+				_zs.next_out = &_window[_windowPos];
+				_zs.avail_out = (uInt) len;
+
+				// stops at the end of each deflate block
+				int ret = ::inflate(&_zs, Z_BLOCK);
+
+				if (ret == Z_BUF_ERROR) {
+					// no input left, the deflate data is truncated
+					return -1;
+				}
+
+				if (ret != Z_OK && ret != Z_STREAM_END) {
+					// the deflate data is corrupted
+					return -1;
+				}
+
+				zip_uint64_t nread = len - _zs.avail_out;
+
+				std::memcpy(buf + total, &_window[_windowPos], (std::size_t) nread);
+
+				total += nread;
+				_pos += nread;
+				_windowPos = (_windowPos + (std::size_t) nread) % WindowSize;
+				_windowFill = std::min(_windowFill + (std::size_t) nread, std::size_t(WindowSize));
+
+				if (ret == Z_STREAM_END) {
+					_isAtEnd = true;
+					break;
+				}
+
+				// at the end of a block that is not the last one
+				bool isAtBlockEnd = (_zs.data_type & 128) && !(_zs.data_type & 64);
+
+				if (isAtBlockEnd && _pos >= getNextCheckpointPos()) {
+					addCheckpoint();
+				}
+
+			}
+
+			return (zip_int64_t) total;
+		}
+
+		bool seek(ZipFileHandle& fileHandle, zip_uint64_t pos) override
+		{
+			if (pos == _pos && _isValid) {
+				return true;
+			}
+
+			// the last checkpoint at or before the position
+			auto next = std::upper_bound(
+				_checkpoints.begin(),
+				_checkpoints.end(),
+				pos,
+				[](zip_uint64_t value, const Checkpoint& checkpoint)
+				{
+					return value < checkpoint.pos;
+				}
+			);
+
+			const Checkpoint* checkpoint =
+				next == _checkpoints.begin() ? nullptr : &*(next - 1);
+
+			zip_uint64_t resumePos = checkpoint ? checkpoint->pos : 0;
+
+			if (!_isValid || pos < _pos || resumePos > _pos) {
+
+				if (!restore(fileHandle, checkpoint)) {
+					return false;
+				}
+
+			}
+
+			return skip(fileHandle, pos - _pos);
+		}
+
+		std::size_t getNumOfCheckpoints() const
+		{
+			return _checkpoints.size();
+		}
+
+	private:
+
+		struct Checkpoint {
+
+			// position in the output
+			zip_uint64_t pos;
+			// position of the next byte in the raw data
+			zip_uint64_t inputPos;
+			// number of bits of the previous byte not used yet
+			int bits;
+			// the output before pos, up to WindowSize bytes
+			std::vector<unsigned char> window;
+
+		};
+
+		std::size_t _interval;
+		z_stream _zs;
+
+		std::vector<unsigned char> _input;
+		// position in the raw data after the input buffer
+		zip_uint64_t _inputPos;
+
+		// circular buffer of the last output
+		std::vector<unsigned char> _window;
+		std::size_t _windowPos;
+		std::size_t _windowFill;
+
+		zip_uint64_t _pos;
+		bool _isAtEnd;
+		// false after a failed restore until the next one
+		bool _isValid;
+
+		std::vector<Checkpoint> _checkpoints;
+
+		zip_uint64_t getNextCheckpointPos() const
+		{
+			return (_checkpoints.empty() ? 0 : _checkpoints.back().pos) + _interval;
+		}
+
+		void addCheckpoint()
+		{
+			Checkpoint checkpoint;
+
+			checkpoint.pos = _pos;
+			checkpoint.inputPos = _inputPos - _zs.avail_in;
+			checkpoint.bits = _zs.data_type & 7;
+
+			// the oldest data of a full window starts at the write position
+			if (_windowFill < WindowSize) {
+				checkpoint.window.assign(_window.begin(), _window.begin() + _windowFill);
+			}
+			else {
+				checkpoint.window.assign(_window.begin() + _windowPos, _window.end());
+				checkpoint.window.insert(
+					checkpoint.window.end(),
+					_window.begin(),
+					_window.begin() + _windowPos
+				);
+			}
+
+			_checkpoints.push_back(std::move(checkpoint));
+		}
+
+		// resumes inflating at the checkpoint or at the beginning if it is nullptr
+		bool restore(ZipFileHandle& fileHandle, const Checkpoint* checkpoint)
+		{
+			_isValid = false;
+
+			zip_uint64_t inputPos = checkpoint ? checkpoint->inputPos : 0;
+			int bits = checkpoint ? checkpoint->bits : 0;
+
+			// the block starts within the previous byte
+			if (bits > 0) {
+				inputPos--;
+			}
+
+			if (fileHandle.seek((zip_int64_t) inputPos, SEEK_SET) != 0) {
+				return false;
+			}
+
+			if (inflateReset(&_zs) != Z_OK) {
+				return false;
+			}
+
+			_zs.avail_in = 0;
+			_inputPos = inputPos;
+			_isAtEnd = false;
+			_windowPos = 0;
+			_windowFill = 0;
+			_pos = 0;
+
+			if (bits > 0) {
+
+				unsigned char byte;
+
+				if (fileHandle.read(&byte, 1) != 1) {
+					return false;
+				}
+
+				_inputPos++;
+
+				if (inflatePrime(&_zs, bits, byte >> (8 - bits)) != Z_OK) {
+					return false;
+				}
+
+			}
+
+			if (checkpoint) {
+
+				std::size_t size = checkpoint->window.size();
+
+				std::copy(checkpoint->window.begin(), checkpoint->window.end(), _window.begin());
+
+				_windowFill = size;
+				_windowPos = size % WindowSize;
+
+				if (inflateSetDictionary(&_zs, checkpoint->window.data(), (uInt) size) != Z_OK) {
+					return false;
+				}
+
+				_pos = checkpoint->pos;
+			}
+
+			_isValid = true;
+
+			return true;
+		}
+
+		// inflates and drops the given number of bytes
+		bool skip(ZipFileHandle& fileHandle, zip_uint64_t nbytes)
+		{
+			if (nbytes == 0) {
+				return true;
+			}
+
+			auto buf = BufferPool::acquire(InputBufferSize);
+
+			while (nbytes > 0) {
+
+				zip_uint64_t len = nbytes < buf.size() ? nbytes : buf.size();
+				zip_int64_t nread = read(fileHandle, buf.data(), len);
+
+				if (nread <= 0) {
+					// failed or the entry is shorter
+					return false;
+				}
+
+				nbytes -= (zip_uint64_t) nread;
+			}
+
+			return true;
+		}
+
+	};
+
+}
@@ -4,6 +4,7 @@
 #include "SeekableSourceStream.h"
 
 namespace Zip {
+inline namespace ZIPCPP_METRICS_NAMESPACE {
 
 	// Creates an instance of input archive stream.
 	template<typename InputStream>
@@ -64,4 +65,5 @@ namespace Zip {
 		);
 	}
 
+}
 }
\ No newline at end of file
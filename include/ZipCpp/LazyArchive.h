@@ -0,0 +1,674 @@
+#pragma once
+
+#include "BufferPool.h"
+#include "Crc32.h"
+#include "MappedFile.h"
+#include "SidecarIndex.h"
+
+#include <zlib.h>
+
+#include <climits>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// This header requires zlib, so it is not included by ZipCpp.h.
+// Usage: Zip::OpenLazyArchive(filePath, indexPath)->readEntry(entryPath, buffer);
+
+namespace Zip {
+
+	// This class reads single entries of huge archives without letting libzip
+	// parse the whole central directory. Opening reads only the end of central
+	// directory record, lookups walk the central directory on demand and
+	// remember the records passed on the way, so each record is parsed at most
+	// once and finding one entry near the beginning costs next to nothing.
+	// With a SidecarIndex the central directory is not read at all.
+	// Data is read straight from the memory of the archive, stored and deflated
+	// entries are supported, encrypted entries are not. The class is meant
+	// for reading by one thread at a time.
+	// Unlike Archive::entry, which by default ignores case and guesses
+	// the encoding of names, lookups match a name byte for byte as it is
+	// stored in the central directory (like ZIP_FL_ENC_RAW without
+	// ZIP_FL_NOCASE), and so does the SidecarIndex.
+
+	class LazyArchive {
+	public:
+
+		typedef std::shared_ptr<LazyArchive> SharedPtr;
+		typedef std::shared_ptr<const void> Owner;
+
+		static const std::uint16_t MethodStore = 0;
+		static const std::uint16_t MethodDeflate = 8;
+
+		// size of chunks passed to exportTo sinks
+		static const std::size_t ChunkSize = 256 * 1024;
+
+		// describes an entry by its central directory record
+		typedef SidecarIndex::Entry EntryInfo;
+
+		// the owner keeps the memory alive as long as the archive exists
+		LazyArchive(
+			const void* data,
+			std::uint64_t size,
+			Owner owner = nullptr
+		) :
+			_data(static_cast<const unsigned char*>(data)),
+			_size(size),
+			_owner(owner),
+			_numOfEntries(0),
+			_eocdOffset(0),
+			_cdOffset(0),
+			_cdEnd(0),
+			_scanPos(0),
+			_numOfScanned(0),
+			_crcCheck(CrcCheck::Default)
+		{
+			readEndOfCentralDirectory();
+		}
+
+		std::uint64_t getNumOfEntries() const
+		{
+			return _numOfEntries;
+		}
+
+		// returns how many central directory records have been parsed so far
+		std::uint64_t getNumOfParsedEntries() const
+		{
+			return _numOfScanned;
+		}
+
+		// Default and Verify check the crc of every entry read as a whole,
+		// Skip reads trusted archives unchecked.
+		void setCrcCheck(CrcCheck crcCheck)
+		{
+			_crcCheck = crcCheck;
+		}
+
+		CrcCheck getCrcCheck() const
+		{
+			return _crcCheck;
+		}
+
+		// returns the key a sidecar index of this archive is made for,
+		// the modification time is known only to the caller
+		SidecarIndex::Key getIndexKey(std::int64_t archiveMTime) const
+		{
+			SidecarIndex::Key key;
+
+			key.archiveSize = _size;
+			key.archiveMTime = archiveMTime;
+			key.tailHash = SidecarIndex::hashName(
+				reinterpret_cast<const char*>(_data + _eocdOffset),
+				(std::size_t) (_size - _eocdOffset)
+			);
+
+			return key;
+		}
+
+		// Lets the index answer lookups instead of the central directory,
+		// the caller checks that the index matches the archive.
+		void setIndex(SidecarIndex::SharedPtr index)
+		{
+			if (index && index->getNumOfEntries() != _numOfEntries) {
+				throw std::logic_error("index does not match the archive");
+			}
+
+			_index = index;
+		}
+
+		SidecarIndex::SharedPtr getIndex() const
+		{
+			return _index;
+		}
+
+		// writes a sidecar index of all entries for the next opens
+		void saveIndex(const std::string& indexPath, std::int64_t archiveMTime)
+		{
+			std::vector<EntryInfo> entries;
+
+			entries.reserve((std::size_t) _numOfEntries);
+
+			forEachEntry([&entries](const EntryInfo& info)
+			{
+				entries.push_back(info);
+			});
+
+			SidecarIndex::write(indexPath, getIndexKey(archiveMTime), entries);
+		}
+
+		bool hasEntry(const std::string& entryPath)
+		{
+			EntryInfo info;
+			return findEntry(entryPath, info);
+		}
+
+		EntryInfo getEntryInfo(const std::string& entryPath)
+		{
+			EntryInfo info;
+
+			if (!findEntry(entryPath, info)) {
+				throw std::logic_error("archive file entry not found");
+			}
+
+			return info;
+		}
+
+		// calls callback(const EntryInfo&) for every entry in the order
+		// of the central directory, the records are not remembered
+		template<typename Callback>
+		void forEachEntry(Callback callback)
+		{
+			std::uint64_t offset = _cdOffset;
+
+			for (std::uint64_t i = 0; i < _numOfEntries; i++) {
+
+				const EntryInfo info = parseRecord(offset);
+
+				callback(info);
+				offset += recordSize(offset);
+
+			}
+		}
+
+		// passes the data to sink(const char* data, std::size_t len) chunk by chunk
+		template<typename Sink>
+		void exportTo(const std::string& entryPath, Sink sink)
+		{
+			exportTo(getEntryInfo(entryPath), sink);
+		}
+
+		template<typename Sink>
+		void exportTo(const EntryInfo& info, Sink sink)
+		{
+			const unsigned char* compData = getEntryData(info);
+
+			std::uint32_t crc = 0;
+			std::uint64_t size = 0;
+
+			bool checkCrc = _crcCheck != CrcCheck::Skip;
+
+			auto consume = [&sink, &crc, &size, checkCrc](const char* data, std::size_t len)
+			{
+				if (checkCrc) {
+					crc = Crc32::update(crc, data, len);
+				}
+
+				size += len;
+				sink(data, len);
+			};
+
+			if (info.method == MethodStore) {
+
+				for (std::uint64_t pos = 0; pos < info.compSize; ) {
+
+					std::size_t len = (std::size_t) (
+						info.compSize - pos < ChunkSize ? info.compSize - pos : ChunkSize
+					);
+
+					consume(reinterpret_cast<const char*>(compData + pos), len);
+					pos += len;
+
+				}
+
+			}
+			else {
+
+				auto buf = BufferPool::acquire(ChunkSize);
+
+				inflateEntry(info, compData, buf.data(), buf.size(), consume);
+
+			}
+
+			checkEntry(info, crc, size, checkCrc);
+		}
+
+		// Reads the whole entry into the buffer, its capacity is reused when
+		// reading more entries. Returns the size of the entry.
+		std::size_t readEntry(const std::string& entryPath, std::vector<char>& buffer)
+		{
+			EntryInfo info = getEntryInfo(entryPath);
+
+			if (info.size > (std::uint64_t) buffer.max_size()) {
+				throw std::runtime_error("archive entry is too large for memory");
+			}
+
+			buffer.resize((std::size_t) info.size);
+
+			std::size_t pos = 0;
+
+			exportTo(info, [&buffer, &pos](const char* data, std::size_t len)
+			{
+				if (len > buffer.size() - pos) {
+					throw std::runtime_error("archive entry is larger than its declared size");
+				}
+
+				std::memcpy(buffer.data() + pos, data, len);
+				pos += len;
+			});
+
+			return pos;
+		}
+
+	private:
+
+		static const std::uint32_t LocalHeaderSignature = 0x04034b50;
+		static const std::uint32_t CentralHeaderSignature = 0x02014b50;
+		static const std::uint32_t EndOfCentralDirSignature = 0x06054b50;
+		static const std::uint32_t Zip64LocatorSignature = 0x07064b50;
+		static const std::uint32_t Zip64EndOfCentralDirSignature = 0x06064b50;
+
+		static const std::size_t LocalHeaderSize = 30;
+		static const std::size_t CentralHeaderSize = 46;
+		static const std::size_t EndOfCentralDirSize = 22;
+		static const std::size_t Zip64LocatorSize = 20;
+		static const std::size_t Zip64EndOfCentralDirSize = 56;
+
+		const unsigned char* _data;
+		std::uint64_t _size;
+		Owner _owner;
+
+		std::uint64_t _numOfEntries;
+		std::uint64_t _eocdOffset;
+		std::uint64_t _cdOffset;
+		std::uint64_t _cdEnd;
+
+		// the central directory has been walked up to here
+		std::uint64_t _scanPos;
+		std::uint64_t _numOfScanned;
+
+		// hashes of names to offsets of their records
+		std::unordered_multimap<std::uint64_t, std::uint64_t> _records;
+
+		SidecarIndex::SharedPtr _index;
+
+		CrcCheck _crcCheck;
+
+		static std::uint16_t read16(const unsigned char* p)
+		{
+			return (std::uint16_t) (p[0] | p[1] << 8);
+		}
+
+		static std::uint32_t read32(const unsigned char* p)
+		{
+			return (std::uint32_t) read16(p) | (std::uint32_t) read16(p + 2) << 16;
+		}
+
+		static std::uint64_t read64(const unsigned char* p)
+		{
+			return (std::uint64_t) read32(p) | (std::uint64_t) read32(p + 4) << 32;
+		}
+
+		static void fail(const char* message)
+		{
+			throw std::runtime_error(
+				std::string("invalid zip archive -> ") + message
+			);
+		}
+
+		// returns the data at the offset after checking that len bytes are there
+		const unsigned char* at(std::uint64_t offset, std::uint64_t len) const
+		{
+			if (offset > _size || len > _size - offset) {
+				fail("data out of bounds");
+			}
+
+			return _data + offset;
+		}
+
+		void readEndOfCentralDirectory()
+		{
+			if (_size < EndOfCentralDirSize) {
+				fail("end of central directory not found");
+			}
+
+			// the record is followed by a comment of up to 64 KiB
+			std::uint64_t lowest = _size > EndOfCentralDirSize + 0xFFFF
+				? _size - EndOfCentralDirSize - 0xFFFF : 0;
+
+			std::uint64_t eocd = _size - EndOfCentralDirSize;
+
+			while (read32(_data + eocd) != EndOfCentralDirSignature) {
+
+				if (eocd == lowest) {
+					fail("end of central directory not found");
+				}
+
+				eocd--;
+			}
+
+			const unsigned char* p = _data + eocd;
+
+			_eocdOffset = eocd;
+			_numOfEntries = read16(p + 10);
+			_cdOffset = read32(p + 16);
+
+			std::uint64_t cdSize = read32(p + 12);
+
+			if (eocd >= Zip64LocatorSize &&
+				read32(_data + eocd - Zip64LocatorSize) == Zip64LocatorSignature)
+			{
+				std::uint64_t eocd64 = read64(_data + eocd - Zip64LocatorSize + 8);
+				const unsigned char* q = at(eocd64, Zip64EndOfCentralDirSize);
+
+				if (read32(q) != Zip64EndOfCentralDirSignature) {
+					fail("zip64 end of central directory not found");
+				}
+
+				_numOfEntries = read64(q + 32);
+				cdSize = read64(q + 40);
+				_cdOffset = read64(q + 48);
+			}
+
+			at(_cdOffset, cdSize);
+
+			_cdEnd = _cdOffset + cdSize;
+			_scanPos = _cdOffset;
+		}
+
+		// returns the size of the central directory record at the offset
+		std::uint64_t recordSize(std::uint64_t offset) const
+		{
+			const unsigned char* p = at(offset, CentralHeaderSize);
+
+			if (read32(p) != CentralHeaderSignature || offset + CentralHeaderSize > _cdEnd) {
+				fail("central directory record not found");
+			}
+
+			std::uint64_t size = CentralHeaderSize
+				+ read16(p + 28) + read16(p + 30) + read16(p + 32);
+
+			if (offset + size > _cdEnd) {
+				fail("central directory record out of bounds");
+			}
+
+			return size;
+		}
+
+		EntryInfo parseRecord(std::uint64_t offset) const
+		{
+			recordSize(offset);
+
+			const unsigned char* p = _data + offset;
+
+			std::uint16_t nameLen = read16(p + 28);
+			std::uint16_t extraLen = read16(p + 30);
+
+			EntryInfo info;
+
+			info.name.assign(reinterpret_cast<const char*>(p + CentralHeaderSize), nameLen);
+			info.flags = read16(p + 8);
+			info.method = read16(p + 10);
+			info.crc = read32(p + 16);
+			info.compSize = read32(p + 20);
+			info.size = read32(p + 24);
+			info.localHeaderOffset = read32(p + 42);
+
+			// sizes that do not fit are in the zip64 extra field in this order
+			const unsigned char* extra = p + CentralHeaderSize + nameLen;
+			const unsigned char* extraEnd = extra + extraLen;
+
+			while (extraEnd - extra >= 4) {
+
+				std::uint16_t id = read16(extra);
+				std::uint16_t len = read16(extra + 2);
+
+				const unsigned char* field = extra + 4;
+				const unsigned char* fieldEnd = field + len;
+
+				if (fieldEnd > extraEnd) {
+					break;
+				}
+
+				if (id == 0x0001) {
+
+					std::uint64_t* values[] = { &info.size, &info.compSize, &info.localHeaderOffset };
+
+					for (std::uint64_t* value : values) {
+
+						if (*value == 0xFFFFFFFF && fieldEnd - field >= 8) {
+							*value = read64(field);
+							field += 8;
+						}
+
+					}
+
+				}
+
+				extra = fieldEnd;
+			}
+
+			return info;
+		}
+
+		bool findEntry(const std::string& entryPath, EntryInfo& info)
+		{
+			if (_index) {
+				return _index->find(entryPath, info);
+			}
+
+			std::uint64_t recordOffset;
+
+			if (!locate(entryPath, recordOffset)) {
+				return false;
+			}
+
+			info = parseRecord(recordOffset);
+			return true;
+		}
+
+		// finds the record of the entry, walks the central directory further
+		// if the entry has not been seen yet, the first of equal names wins
+		bool locate(const std::string& entryPath, std::uint64_t& recordOffset)
+		{
+			std::uint64_t hash = SidecarIndex::hashName(entryPath.data(), entryPath.size());
+
+			bool found = false;
+
+			auto range = _records.equal_range(hash);
+
+			for (auto it = range.first; it != range.second; ++it) {
+
+				if ((!found || it->second < recordOffset) && hasName(it->second, entryPath)) {
+					recordOffset = it->second;
+					found = true;
+				}
+
+			}
+
+			if (found) {
+				return true;
+			}
+
+			while (_numOfScanned < _numOfEntries) {
+
+				std::uint64_t offset = _scanPos;
+
+				_scanPos += recordSize(offset);
+				_numOfScanned++;
+
+				const unsigned char* p = _data + offset;
+
+				const char* name = reinterpret_cast<const char*>(p + CentralHeaderSize);
+				std::uint16_t nameLen = read16(p + 28);
+
+				std::uint64_t recordHash = SidecarIndex::hashName(name, nameLen);
+
+				_records.emplace(recordHash, offset);
+
+				if (recordHash == hash && hasName(offset, entryPath)) {
+					recordOffset = offset;
+					return true;
+				}
+
+			}
+
+			return false;
+		}
+
+		bool hasName(std::uint64_t offset, const std::string& entryPath) const
+		{
+			const unsigned char* p = _data + offset;
+
+			return read16(p + 28) == entryPath.size() &&
+				std::memcmp(p + CentralHeaderSize, entryPath.data(), entryPath.size()) == 0;
+		}
+
+		// returns the compressed data of the entry after its local header
+		const unsigned char* getEntryData(const EntryInfo& info) const
+		{
+			if (info.flags & 0x0001) {
+				throw std::logic_error("encrypted entries cannot be read from a lazy archive");
+			}
+
+			if (info.method != MethodStore && info.method != MethodDeflate) {
+				throw std::logic_error("compression method is not supported by a lazy archive");
+			}
+
+			const unsigned char* p = at(info.localHeaderOffset, LocalHeaderSize);
+
+			if (read32(p) != LocalHeaderSignature) {
+				fail("local file header not found");
+			}
+
+			std::uint64_t dataOffset = info.localHeaderOffset
+				+ LocalHeaderSize + read16(p + 26) + read16(p + 28);
+
+			return at(dataOffset, info.compSize);
+		}
+
+		// inflates the raw deflate data and passes it to consume(data, len)
+		template<typename Consume>
+		static void inflateEntry(
+			const EntryInfo& info,
+			const unsigned char* compData,
+			char* buf,
+			std::size_t bufSize,
+			Consume consume
+		)
+		{
+			z_stream zs = z_stream();
+
+			if (inflateInit2(&zs, -MAX_WBITS) != Z_OK) {
+				throw std::runtime_error("cannot initialize inflate stream");
+			}
+
+			std::uint64_t remaining = info.compSize;
+			uInt outSize = bufSize < UINT_MAX ? (uInt) bufSize : UINT_MAX;
+			int ret = Z_OK;
+
+			try {
+
+				while (ret != Z_STREAM_END) {
+
+					if (zs.avail_in == 0 && remaining > 0) {
+
+						uInt len = remaining < UINT_MAX ? (uInt) remaining : UINT_MAX;
+
+						zs.next_in = const_cast<Bytef*>(compData + (info.compSize - remaining));
+						zs.avail_in = len;
+
+						remaining -= len;
+					}
+
+					zs.next_out = reinterpret_cast<Bytef*>(buf);
+					zs.avail_out = outSize;
+
+					ret = ::inflate(&zs, Z_NO_FLUSH);
+
+					if (ret == Z_BUF_ERROR && zs.avail_in == 0 && remaining == 0) {
+						fail("deflate data is truncated");
+					}
+
+					if (ret != Z_OK && ret != Z_STREAM_END && ret != Z_BUF_ERROR) {
+						fail("deflate data is corrupted");
+					}
+
+					if (zs.avail_out < outSize) {
+						consume(buf, (std::size_t) (outSize - zs.avail_out));
+					}
+
+				}
+
+			}
+			catch (...) {
+				inflateEnd(&zs);
+				throw;
+			}
+
+			inflateEnd(&zs);
+		}
+
+		static void checkEntry(const EntryInfo& info, std::uint32_t crc, std::uint64_t size, bool checkCrc)
+		{
+			if (size != info.size) {
+				throw std::runtime_error("size of archive entry does not match");
+			}
+
+			if (checkCrc && crc != info.crc) {
+				throw std::runtime_error("crc of archive entry does not match");
+			}
+		}
+
+	};
+
+	// Opens the archive lazily over a memory-mapped file, only the pages
+	// of the records and entries that are read are loaded from disk.
+	inline LazyArchive::SharedPtr OpenLazyArchive(const std::string& filePath)
+	{
+		auto mappedFile = std::make_shared<MappedFile>(filePath);
+
+		return std::make_shared<LazyArchive>(
+			mappedFile->data(),
+			mappedFile->size(),
+			mappedFile
+		);
+	}
+
+	// Opens the archive lazily with the sidecar index at indexPath, lookups
+	// then take O(1) without reading the central directory. A missing or stale
+	// index is written anew for the next opens. If that fails, e.g. in a read-only
+	// directory, the archive is returned without an index and looks entries up
+	// in the central directory.
+	inline LazyArchive::SharedPtr OpenLazyArchive(
+		const std::string& filePath,
+		const std::string& indexPath
+	)
+	{
+		// taken before mapping, so a later change of the archive is noticed
+		std::int64_t archiveMTime = SidecarIndex::getFileMTime(filePath);
+
+		auto archive = OpenLazyArchive(filePath);
+		auto key = archive->getIndexKey(archiveMTime);
+		auto index = SidecarIndex::open(indexPath);
+
+		if (!index || !index->matches(key)) {
+
+			index = nullptr;
+
+			try {
+				archive->saveIndex(indexPath, archiveMTime);
+				// another process may have replaced it in the meantime
+				index = SidecarIndex::open(indexPath);
+			}
+			catch (const std::exception&) {
+				// the index only speeds up the lookups
+			}
+
+			if (index && !index->matches(key)) {
+				index = nullptr;
+			}
+
+		}
+
+		if (index) {
+			archive->setIndex(index);
+		}
+
+		return archive;
+	}
+
+}
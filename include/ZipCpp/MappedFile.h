@@ -0,0 +1,154 @@
+#pragma once
+
+#include <cerrno>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <string>
+
+#ifdef _WIN32
+	#ifndef NOMINMAX
+		#define NOMINMAX
+	#endif
+	#include <windows.h>
+#else
+	#include <fcntl.h>
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <unistd.h>
+#endif
+
+// This class maps a whole file read-only into memory
+
+namespace Zip {
+
+	class MappedFile {
+	public:
+
+		typedef std::shared_ptr<MappedFile> SharedPtr;
+
+		explicit MappedFile(const std::string& filePath) :
+			_data(nullptr),
+			_size(0)
+		{
+			#ifdef _WIN32
+
+				HANDLE file = CreateFileA(
+					filePath.c_str(),
+					GENERIC_READ,
+					FILE_SHARE_READ,
+					NULL,
+					OPEN_EXISTING,
+					FILE_ATTRIBUTE_NORMAL,
+					NULL
+				);
+
+				if (file == INVALID_HANDLE_VALUE) {
+					throw std::runtime_error(
+						"cannot open file for mapping -> " + filePath
+					);
+				}
+
+				LARGE_INTEGER fileSize;
+
+				if (!GetFileSizeEx(file, &fileSize)) {
+					CloseHandle(file);
+					throw std::runtime_error(
+						"cannot get size of file for mapping -> " + filePath
+					);
+				}
+
+				_size = (unsigned long long) fileSize.QuadPart;
+
+				if (_size > 0) {
+
+					HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+
+					if (mapping) {
+						_data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+						CloseHandle(mapping);
+					}
+
+				}
+
+				CloseHandle(file);
+
+			#else
+
+				int fd = ::open(filePath.c_str(), O_RDONLY);
+
+				if (fd < 0) {
+					throw std::runtime_error(
+						"cannot open file for mapping -> " + filePath
+							+ ": " + std::strerror(errno)
+					);
+				}
+
+				struct stat fileStat;
+
+				if (::fstat(fd, &fileStat) != 0) {
+					int err = errno;
+					::close(fd);
+					throw std::runtime_error(
+						"cannot get size of file for mapping -> " + filePath
+							+ ": " + std::strerror(err)
+					);
+				}
+
+				_size = (unsigned long long) fileStat.st_size;
+
+				if (_size > 0) {
+
+					void* data = ::mmap(nullptr, (size_t) _size, PROT_READ, MAP_SHARED, fd, 0);
+
+					if (data != MAP_FAILED) {
+						_data = data;
+					}
+
+				}
+
+				::close(fd);
+
+			#endif
+
+			if (_size > 0 && !_data) {
+				throw std::runtime_error(
+					"cannot map file into memory -> " + filePath
+				);
+			}
+		}
+
+		MappedFile(const MappedFile&) = delete;
+		MappedFile& operator= (const MappedFile&) = delete;
+
+		~MappedFile()
+		{
+			if (_data) {
+
+				#ifdef _WIN32
+					UnmapViewOfFile(_data);
+				#else
+					::munmap(_data, (size_t) _size);
+				#endif
+
+			}
+		}
+
+		const char* data() const
+		{
+			return reinterpret_cast<const char*>(_data);
+		}
+
+		unsigned long long size() const
+		{
+			return _size;
+		}
+
+	private:
+
+		void* _data;
+		unsigned long long _size;
+
+	};
+
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include "Archive.h"
+#include "MappedFile.h"
+#include "MemoryArchive.h"
+
+namespace Zip {
+inline namespace ZIPCPP_METRICS_NAMESPACE {
+
+	// Opens a zip archive handle over the file mapping.
+	inline ZipHandle::SharedPtr OpenMappedZipHandle(MappedFile::SharedPtr mappedFile)
+	{
+		return OpenMemoryZipHandle(
+			mappedFile->data(),
+			mappedFile->size(),
+			mappedFile
+		);
+	}
+
+	// Creates an instance of input archive backed by an existing file mapping,
+	// the mapping can be shared by more archives.
+	inline Archive MakeMappedInputArchive(MappedFile::SharedPtr mappedFile)
+	{
+		return Archive(
+			[mappedFile]()
+			{
+				return OpenMappedZipHandle(mappedFile);
+			}
+		);
+	}
+
+	// Creates an instance of input archive backed by a memory-mapped file.
+	inline Archive MakeMappedInputArchive(const std::string& filePath)
+	{
+		return Archive(
+			[filePath]()
+			{
+				// the file is mapped when the archive is opened
+				return OpenMappedZipHandle(
+					std::make_shared<MappedFile>(filePath)
+				);
+			}
+		);
+	}
+
+	// Creates a shared pointer to input archive backed by a memory-mapped file.
+	inline Archive::SharedPtr MakeSharedMappedInputArchive(const std::string& filePath)
+	{
+		return std::make_shared<Archive>(
+			MakeMappedInputArchive(filePath)
+		);
+	}
+
+}
+}
@@ -0,0 +1,112 @@
+#pragma once
+
+#include "Archive.h"
+#include "MemorySourceStream.h"
+#include "OutputArchiveStream.h"
+#include "VectorOutputStream.h"
+
+#include <vector>
+
+namespace Zip {
+inline namespace ZIPCPP_METRICS_NAMESPACE {
+
+	// Opens a zip archive handle over a contiguous block of memory,
+	// the owner keeps the memory alive as long as the handle exists.
+	inline ZipHandle::SharedPtr OpenMemoryZipHandle(
+		const void* data,
+		zip_uint64_t size,
+		MemorySourceStream::Owner owner = nullptr
+	)
+	{
+		auto memorySource = std::make_shared<MemorySourceStream>(
+			data,
+			size,
+			owner
+		);
+
+		Error error;
+
+		zip_source_t* zipSrcPtr = zip_source_function_create(
+			&MemorySourceStream::dispatch,
+			memorySource.get(),
+			error.getInternalStructPtr()
+		);
+
+		if (!zipSrcPtr) {
+
+			throw std::runtime_error(
+				"cannot create a zip archive source -> "
+					+ error.getErrMessage()
+			);
+
+		}
+
+		zip_t* newZipPtr = zip_open_from_source(
+			zipSrcPtr,
+			ZIP_RDONLY,
+			error.getInternalStructPtr()
+		);
+
+		if (!newZipPtr) {
+
+			zip_source_free(zipSrcPtr);
+
+			throw std::runtime_error(
+				"cannot open a zip archive from the data source -> "
+					+ error.getErrMessage()
+			);
+
+		}
+
+		return std::make_shared<ZipHandle>(newZipPtr, memorySource);
+	}
+
+	// Creates an instance of input archive reading directly from memory
+	// without copying it, e.g. MakeInputArchive(body.data(), body.size()).
+	// Without an owner the memory has to outlive the archive.
+	inline Archive MakeInputArchive(
+		const void* data,
+		std::size_t size,
+		MemorySourceStream::Owner owner = nullptr
+	)
+	{
+		return Archive(
+			[data, size, owner]()
+			{
+				return OpenMemoryZipHandle(data, size, owner);
+			}
+		);
+	}
+
+	// Creates a shared pointer to input archive reading directly from memory.
+	inline Archive::SharedPtr MakeSharedInputArchive(
+		const void* data,
+		std::size_t size,
+		MemorySourceStream::Owner owner = nullptr
+	)
+	{
+		return std::make_shared<Archive>(
+			MakeInputArchive(data, size, owner)
+		);
+	}
+
+	// Creates an instance of output archive writing directly into the vector,
+	// libzip output is not buffered once more on the way.
+	inline Archive MakeOutputArchive(std::vector<char>* buffer)
+	{
+		return MakeOutputArchive(
+			std::make_shared<VectorOutputStream>(buffer),
+			0
+		);
+	}
+
+	// Creates a shared pointer to output archive writing into the vector.
+	inline Archive::SharedPtr MakeSharedOutputArchive(std::vector<char>* buffer)
+	{
+		return std::make_shared<Archive>(
+			MakeOutputArchive(buffer)
+		);
+	}
+
+}
+}
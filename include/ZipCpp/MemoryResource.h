@@ -0,0 +1,270 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <type_traits>
+#include <vector>
+
+namespace Zip {
+
+	// This class is the source of memory for objects the wrapper allocates
+	// for an archive, it follows std::pmr::memory_resource which is not
+	// available before C++17.
+
+	class MemoryResource {
+	public:
+
+		typedef std::shared_ptr<MemoryResource> SharedPtr;
+
+		virtual ~MemoryResource() {}
+
+		virtual void* allocate(std::size_t bytes, std::size_t alignment) = 0;
+		virtual void deallocate(void* ptr, std::size_t bytes, std::size_t alignment) = 0;
+
+		// returns the resource using global operator new and delete
+		static SharedPtr getDefault();
+
+	private:
+
+		class NewDeleteResource;
+
+	};
+
+	class MemoryResource::NewDeleteResource : public MemoryResource {
+	public:
+
+		void* allocate(std::size_t bytes, std::size_t) override
+		{
+			return ::operator new(bytes);
+		}
+
+		void deallocate(void* ptr, std::size_t, std::size_t) override
+		{
+			::operator delete(ptr);
+		}
+
+	};
+
+	inline MemoryResource::SharedPtr MemoryResource::getDefault()
+	{
+		// never destroyed and not reference counted, so it can be used
+		// from any thread and at any time without synchronization
+		static NewDeleteResource* instance = new NewDeleteResource();
+		return SharedPtr(SharedPtr(), instance);
+	}
+
+	// lock of an arena used by a single thread
+	struct NullMutex {
+		void lock() {}
+		void unlock() {}
+	};
+
+	// This class hands out memory from large chunks and never frees single
+	// allocations, all chunks are released at once when the arena is destroyed.
+	// An archive keeps the arena it is given alive, and so do the entry streams
+	// opened from it. The Mutex guards the arena, see MonotonicArena
+	// and UnsynchronizedArena.
+
+	template<typename Mutex>
+	class BasicMonotonicArena : public MemoryResource {
+	public:
+
+		static const std::size_t DefaultChunkSize = 16 * 1024;
+
+		BasicMonotonicArena(std::size_t initialChunkSize = DefaultChunkSize) :
+			_nextChunkSize(initialChunkSize),
+			_current(nullptr),
+			_remaining(0),
+			_allocatedBytes(0)
+		{
+			if (_nextChunkSize == 0) {
+				_nextChunkSize = DefaultChunkSize;
+			}
+		}
+
+		~BasicMonotonicArena()
+		{
+			release();
+		}
+
+		BasicMonotonicArena(const BasicMonotonicArena&) = delete;
+		BasicMonotonicArena& operator= (const BasicMonotonicArena&) = delete;
+
+		void* allocate(std::size_t bytes, std::size_t alignment) override
+		{
+			std::lock_guard<Mutex> lock(_mutex);
+
+			if (bytes == 0) {
+				bytes = 1;
+			}
+
+			void* ptr = align(bytes, alignment);
+
+			if (!ptr) {
+
+				// the chunks grow geometrically to keep their count low
+				std::size_t chunkSize = _nextChunkSize;
+
+				while (chunkSize < bytes + alignment) {
+					chunkSize *= 2;
+				}
+
+				// the chunk must not leak if the list cannot grow
+				_chunks.reserve(_chunks.size() + 1);
+				_chunks.push_back(::operator new(chunkSize));
+
+				_current = static_cast<char*>(_chunks.back());
+				_remaining = chunkSize;
+				_nextChunkSize = chunkSize * 2;
+
+				ptr = align(bytes, alignment);
+			}
+
+			_allocatedBytes += bytes;
+
+			return ptr;
+		}
+
+		void deallocate(void*, std::size_t, std::size_t) override
+		{
+			// the memory is returned with the whole arena
+		}
+
+		// frees all chunks, nothing allocated from the arena may be used afterwards
+		void release()
+		{
+			std::lock_guard<Mutex> lock(_mutex);
+
+			for (void* chunk : _chunks) {
+				::operator delete(chunk);
+			}
+
+			_chunks.clear();
+			_current = nullptr;
+			_remaining = 0;
+		}
+
+		// returns the number of bytes handed out since the arena was created
+		std::size_t getAllocatedBytes()
+		{
+			std::lock_guard<Mutex> lock(_mutex);
+			return _allocatedBytes;
+		}
+
+	private:
+
+		Mutex _mutex;
+		std::vector<void*> _chunks;
+		std::size_t _nextChunkSize;
+		char* _current;
+		std::size_t _remaining;
+		std::size_t _allocatedBytes;
+
+		// takes the memory from the current chunk, returns nullptr if it does not fit
+		void* align(std::size_t bytes, std::size_t alignment)
+		{
+			if (!_current) {
+				return nullptr;
+			}
+
+			void* ptr = _current;
+
+			if (!std::align(alignment, bytes, ptr, _remaining)) {
+				return nullptr;
+			}
+
+			_current = static_cast<char*>(ptr) + bytes;
+			_remaining -= bytes;
+
+			return ptr;
+		}
+
+	};
+
+	// arena that can be used from more threads at once
+	typedef BasicMonotonicArena<std::mutex> MonotonicArena;
+
+	// arena without locking for archives used by a single thread at a time,
+	// e.g. one arena per worker thread
+	typedef BasicMonotonicArena<NullMutex> UnsynchronizedArena;
+
+	// This class is a standard allocator over a memory resource. By default
+	// it does not own the resource, like std::pmr::polymorphic_allocator,
+	// so copying it costs nothing. An allocator given the owner keeps
+	// the resource alive, it is meant for objects that may outlive
+	// the archive, such as entry streams.
+
+	template<typename T>
+	class ResourceAllocator {
+	public:
+
+		typedef T value_type;
+
+		// containers take the resource along when they are assigned
+		typedef std::true_type propagate_on_container_copy_assignment;
+		typedef std::true_type propagate_on_container_move_assignment;
+		typedef std::true_type propagate_on_container_swap;
+
+		template<typename U>
+		struct rebind {
+			typedef ResourceAllocator<U> other;
+		};
+
+		ResourceAllocator(MemoryResource* resource = nullptr) :
+			_resource(resource ? resource : MemoryResource::getDefault().get())
+		{}
+
+		ResourceAllocator(MemoryResource* resource, MemoryResource::SharedPtr owner) :
+			_resource(resource ? resource : MemoryResource::getDefault().get()),
+			_owner(std::move(owner))
+		{}
+
+		template<typename U>
+		ResourceAllocator(const ResourceAllocator<U>& other) :
+			_resource(other.getResource()),
+			_owner(other.getOwner())
+		{}
+
+		T* allocate(std::size_t n)
+		{
+			return static_cast<T*>(_resource->allocate(n * sizeof(T), alignof(T)));
+		}
+
+		void deallocate(T* ptr, std::size_t n)
+		{
+			_resource->deallocate(ptr, n * sizeof(T), alignof(T));
+		}
+
+		MemoryResource* getResource() const
+		{
+			return _resource;
+		}
+
+		const MemoryResource::SharedPtr& getOwner() const
+		{
+			return _owner;
+		}
+
+	private:
+
+		MemoryResource* _resource;
+		// empty unless the allocator keeps the resource alive
+		MemoryResource::SharedPtr _owner;
+
+	};
+
+	template<typename T, typename U>
+	bool operator== (const ResourceAllocator<T>& a, const ResourceAllocator<U>& b)
+	{
+		return a.getResource() == b.getResource();
+	}
+
+	template<typename T, typename U>
+	bool operator!= (const ResourceAllocator<T>& a, const ResourceAllocator<U>& b)
+	{
+		return !(a == b);
+	}
+
+}
@@ -0,0 +1,187 @@
+#pragma once
+
+#include "SourceStream.h"
+#include "Error.h"
+#include "Metrics.h"
+
+#include <cstring>
+#include <memory>
+
+#define ZIP_MEMORY_SOURCE_STREAM_SUPPORTS \
+	ZIP_SOURCE_OPEN, \
+	ZIP_SOURCE_READ, \
+	ZIP_SOURCE_CLOSE, \
+	ZIP_SOURCE_STAT, \
+	ZIP_SOURCE_ERROR, \
+	ZIP_SOURCE_FREE, \
+	ZIP_SOURCE_SEEK, \
+	ZIP_SOURCE_TELL, \
+	ZIP_SOURCE_SUPPORTS
+
+namespace Zip {
+inline namespace ZIPCPP_METRICS_NAMESPACE {
+
+	// This class serves archive data directly from a contiguous block of memory,
+	// reads are plain copies and seeking or getting the size are O(1).
+	// The owner pointer keeps the memory alive as long as the source exists.
+
+	class MemorySourceStream : public SourceStream {
+	public:
+
+		typedef std::shared_ptr<MemorySourceStream> SharedPtr;
+		typedef std::shared_ptr<const void> Owner;
+
+		static zip_int64_t dispatch(
+			void *userdata,
+			void *data,
+			zip_uint64_t len,
+			zip_source_cmd_t cmd
+		)
+		{
+			zip_int64_t result = -1;
+
+			MemorySourceStream* src = reinterpret_cast<
+				MemorySourceStream*
+			>(userdata);
+
+			switch (cmd) {
+
+				case ZIP_SOURCE_SUPPORTS: // check whether source supports command
+					result = zip_source_make_command_bitmap(
+						ZIP_MEMORY_SOURCE_STREAM_SUPPORTS,
+						-1
+					);
+				break;
+
+				case ZIP_SOURCE_OPEN: // prepare for reading
+					src->_offset = 0;
+					result = 0;
+				break;
+
+				case ZIP_SOURCE_READ: // read data
+
+					result = src->read(
+						reinterpret_cast<char*>(data),
+						len
+					);
+
+					Metrics::addCount(MetricId::SourceReads);
+					Metrics::addCount(MetricId::SourceReadBytes, result > 0 ? result : 0);
+
+				break;
+
+				case ZIP_SOURCE_CLOSE: // reading is done
+					result = 0;
+				break;
+
+				case ZIP_SOURCE_STAT: // get meta information
+					result = src->stat(
+						reinterpret_cast<zip_stat_t*>(data)
+					);
+				break;
+
+				case ZIP_SOURCE_ERROR: // get error information
+					result = src->_lastError.convToSourceErr(data, len);
+				break;
+
+				case ZIP_SOURCE_FREE: // cleanup and free resources
+					result = 0;
+				break;
+
+				case ZIP_SOURCE_SEEK: // set position for reading
+					result = src->seek(data, len);
+				break;
+
+				case ZIP_SOURCE_TELL: // get read position
+					result = (zip_int64_t) src->_offset;
+				break;
+
+				default: // invalid command
+					src->_lastError.setCode(ZIP_ER_INVAL);
+
+			}
+
+			return result;
+		}
+
+		MemorySourceStream(
+			const void* data,
+			zip_uint64_t size,
+			Owner owner = nullptr
+		) :
+			_data(reinterpret_cast<const char*>(data)),
+			_size(size),
+			_offset(0),
+			_owner(owner)
+		{}
+
+		const char* data() const
+		{
+			return _data;
+		}
+
+		zip_uint64_t size() const
+		{
+			return _size;
+		}
+
+	private:
+
+		const char* _data;
+		zip_uint64_t _size;
+		zip_uint64_t _offset;
+		// keeps the memory block alive
+		Owner _owner;
+		// stores information about the last zip error
+		Error _lastError;
+
+		zip_int64_t read(char* buff, zip_uint64_t len)
+		{
+			zip_uint64_t avail = _size - _offset;
+
+			if (len > avail) {
+				len = avail;
+			}
+
+			if (len > 0) {
+				std::memcpy(buff, _data + _offset, (size_t) len);
+				_offset += len;
+			}
+
+			return (zip_int64_t) len;
+		}
+
+		zip_int64_t stat(zip_stat_t* zipStatPtr)
+		{
+			zip_stat_init(zipStatPtr);
+
+			zipStatPtr->size = _size;
+			zipStatPtr->valid |= ZIP_STAT_SIZE;
+
+			return 0;
+		}
+
+		zip_int64_t seek(void *data, zip_uint64_t len)
+		{
+			// validate arguments and compute a new offset
+			zip_int64_t newOffset = zip_source_seek_compute_offset(
+				_offset,
+				_size,
+				data,
+				len,
+				_lastError.getInternalStructPtr()
+			);
+
+			if (newOffset < 0) {
+				return -1;
+			}
+
+			_offset = (zip_uint64_t) newOffset;
+
+			return 0;
+		}
+
+	};
+
+}
+}
@@ -0,0 +1,224 @@
+#pragma once
+
+#include <zipconf.h>
+#include <zip.h>
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+
+// Instrumentation of archive operations. The policy is chosen at compile time
+// by defining ZIPCPP_METRICS_POLICY as the name of a policy in namespace Zip
+// before ZipCpp headers are included, e.g. as AtomicMetrics. The default
+// policy does nothing and compiles away completely. The code reporting
+// into the policy is put into an inline namespace named after it, so
+// translation units built with different policies do not share definitions,
+// and passing an archive from one to another fails to link.
+
+#ifndef ZIPCPP_METRICS_POLICY
+	#define ZIPCPP_METRICS_POLICY NullMetrics
+#endif
+
+#define ZIPCPP_METRICS_CONCAT_(a, b) a##b
+#define ZIPCPP_METRICS_CONCAT(a, b) ZIPCPP_METRICS_CONCAT_(a, b)
+
+#define ZIPCPP_METRICS_NAMESPACE ZIPCPP_METRICS_CONCAT(With, ZIPCPP_METRICS_POLICY)
+
+namespace Zip {
+
+	enum class MetricId {
+		SourceReads,		// ZIP_SOURCE_READ commands served by source streams
+		SourceReadBytes,
+		SourceWrites,		// ZIP_SOURCE_WRITE commands served by source streams
+		SourceWriteBytes,
+		EntryOpens,			// entries opened for reading
+		EntryReadBytes,		// decompressed bytes read from entries
+		EntryWriteBytes,	// bytes written to entries
+		OpenEntryTime,		// latency of opening an entry
+		SaveAndCloseTime,	// latency of zip_close
+		NumOfMetrics
+	};
+
+	// policy that records nothing
+	struct NullMetrics {
+
+		static const bool Enabled = false;
+
+		static void addCount(MetricId, std::uint64_t = 1) {}
+		static void addLatency(MetricId, std::uint64_t) {}
+		static void addEntrySizes(const char*, zip_uint64_t, zip_uint64_t) {}
+
+	};
+
+	// policy that keeps counters, byte totals and latency histograms
+	// in process-wide atomics
+	struct AtomicMetrics {
+
+		static const bool Enabled = true;
+
+		// bucket i counts latencies from 2^(i-1) up to 2^i nanoseconds
+		static const std::size_t NumOfBuckets = 40;
+
+		typedef std::array<std::uint64_t, NumOfBuckets> Histogram;
+
+		// receives the name, size and compressed size of each opened entry
+		typedef std::function<
+			void(const char*, zip_uint64_t, zip_uint64_t)
+		> EntrySizesHandler;
+
+		static void addCount(MetricId id, std::uint64_t value = 1)
+		{
+			counters()[(std::size_t) id].fetch_add(value, std::memory_order_relaxed);
+		}
+
+		static void addLatency(MetricId id, std::uint64_t nanoseconds)
+		{
+			std::size_t bucket = 0;
+
+			while (bucket + 1 < NumOfBuckets && (nanoseconds >> bucket) != 0) {
+				bucket++;
+			}
+
+			histograms()[(std::size_t) id][bucket].fetch_add(1, std::memory_order_relaxed);
+			addCount(id, nanoseconds);
+		}
+
+		static void addEntrySizes(const char* name, zip_uint64_t size, zip_uint64_t compSize)
+		{
+			EntrySizesHandler handler;
+
+			{
+				std::lock_guard<std::mutex> lock(handlerMutex());
+				handler = entrySizesHandler();
+			}
+
+			// called without the lock, so it may replace itself
+			if (handler) {
+				handler(name, size, compSize);
+			}
+		}
+
+		// returns a count, a byte total or a total time in nanoseconds
+		static std::uint64_t getCount(MetricId id)
+		{
+			return counters()[(std::size_t) id].load(std::memory_order_relaxed);
+		}
+
+		static Histogram getHistogram(MetricId id)
+		{
+			Histogram histogram;
+
+			for (std::size_t i = 0; i < NumOfBuckets; i++) {
+				histogram[i] = histograms()[(std::size_t) id][i].load(std::memory_order_relaxed);
+			}
+
+			return histogram;
+		}
+
+		static void setEntrySizesHandler(EntrySizesHandler handler)
+		{
+			std::lock_guard<std::mutex> lock(handlerMutex());
+			entrySizesHandler() = handler;
+		}
+
+		static void reset()
+		{
+			for (auto& counter : counters()) {
+				counter.store(0, std::memory_order_relaxed);
+			}
+
+			for (auto& histogram : histograms()) {
+				for (auto& bucket : histogram) {
+					bucket.store(0, std::memory_order_relaxed);
+				}
+			}
+		}
+
+	private:
+
+		typedef std::array<
+			std::atomic<std::uint64_t>,
+			(std::size_t) MetricId::NumOfMetrics
+		> Counters;
+
+		typedef std::array<
+			std::array<std::atomic<std::uint64_t>, NumOfBuckets>,
+			(std::size_t) MetricId::NumOfMetrics
+		> Histograms;
+
+		static Counters& counters()
+		{
+			static Counters values {};
+			return values;
+		}
+
+		static Histograms& histograms()
+		{
+			static Histograms values {};
+			return values;
+		}
+
+		static std::mutex& handlerMutex()
+		{
+			static std::mutex mutex;
+			return mutex;
+		}
+
+		static EntrySizesHandler& entrySizesHandler()
+		{
+			static EntrySizesHandler handler;
+			return handler;
+		}
+
+	};
+
+}
+
+namespace Zip {
+inline namespace ZIPCPP_METRICS_NAMESPACE {
+
+	typedef ZIPCPP_METRICS_POLICY Metrics;
+
+	// reports the time from construction to destruction as a latency
+	class MetricsTimer {
+	public:
+
+		explicit MetricsTimer(MetricId id) :
+			_id(id)
+		{
+			if (Metrics::Enabled) {
+				_start = std::chrono::steady_clock::now();
+			}
+		}
+
+		~MetricsTimer()
+		{
+			if (Metrics::Enabled) {
+
+				auto elapsed = std::chrono::steady_clock::now() - _start;
+
+				Metrics::addLatency(
+					_id,
+					(std::uint64_t) std::chrono::duration_cast<
+						std::chrono::nanoseconds
+					>(elapsed).count()
+				);
+
+			}
+		}
+
+		MetricsTimer(const MetricsTimer&) = delete;
+		MetricsTimer& operator= (const MetricsTimer&) = delete;
+
+	private:
+
+		MetricId _id;
+		std::chrono::steady_clock::time_point _start;
+
+	};
+
+}
+}
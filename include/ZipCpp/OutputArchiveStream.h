@@ -5,20 +5,28 @@
 #include "NullInputStream.h"
 
 namespace Zip {
+inline namespace ZIPCPP_METRICS_NAMESPACE {
 
-	// Create an instance of output archive stream.
+	// Create an instance of output archive stream, data written by libzip
+	// are passed to the stream in blocks of writeBufferSize bytes.
 	template<typename OutputStream>
-	Archive MakeOutputArchive(OutputStream outputStream)
+	Archive MakeOutputArchive(
+		OutputStream outputStream,
+		std::size_t writeBufferSize = WritableSourceStream<
+			NullInputStream::SharedPtr,
+			OutputStream
+		>::DefaultWriteBufferSize
+	)
 	{
 		return Archive(
-			[outputStream]()
+			[outputStream, writeBufferSize]()
 			{
 				auto writableSource = std::make_shared<
 					WritableSourceStream<
 						NullInputStream::SharedPtr,
 						OutputStream
 					>
-				>(std::make_shared<NullInputStream>(), outputStream);
+				>(std::make_shared<NullInputStream>(), outputStream, writeBufferSize);
 
 				Error error;
 
@@ -64,11 +72,18 @@ namespace Zip {
 
 	// Creates a shared pointer to output archive stream.
 	template<typename OutputStream>
-	Archive::SharedPtr MakeSharedOutputArchive(OutputStream outputStream)
+	Archive::SharedPtr MakeSharedOutputArchive(
+		OutputStream outputStream,
+		std::size_t writeBufferSize = WritableSourceStream<
+			NullInputStream::SharedPtr,
+			OutputStream
+		>::DefaultWriteBufferSize
+	)
 	{
 		return std::make_shared<Archive>(
-			MakeOutputArchive(outputStream)
+			MakeOutputArchive(outputStream, writeBufferSize)
 		);
 	}
 
+}
 }
\ No newline at end of file
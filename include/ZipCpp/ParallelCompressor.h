@@ -0,0 +1,592 @@
+#pragma once
+
+#include "ZipHandle.h"
+#include "ThreadPool.h"
+#include "SpoolStream.h"
+#include "PreparedSourceStream.h"
+#include "Crc32.h"
+
+#include <zlib.h>
+
+#include <stdexcept>
+#include <vector>
+
+// This header requires zlib, so it is not included by ZipCpp.h.
+// Usage: archive.saveAndClose(Zip::ParallelCompressor(numOfThreads));
+
+namespace Zip {
+inline namespace ZIPCPP_METRICS_NAMESPACE {
+
+	// Deflates data of pending entries on a pool of threads before the archive
+	// is saved, zip_close then only copies the compressed data in entry order.
+	// Entries with ZIP_CM_DEFAULT and ZIP_CM_DEFLATE are deflated with libzip's
+	// usual settings, but the compressed data is not guaranteed to be the same
+	// as libzip's; entries with other methods are compressed by libzip.
+	// If compressing fails, the entries compressed so far keep their data and
+	// the others are read once more from the beginning when the archive is saved.
+	// Optionally, huge entries are split into blocks deflated on all threads,
+	// see setBlockSplitting.
+
+	class ParallelCompressor {
+	public:
+
+		// size of the input buffer libzip's compression layer reads into;
+		// entries that fit into it may be stored instead of deflated
+		static const std::size_t LibzipBufferSize = 8192;
+
+		static const std::size_t DefaultBlockSize = 1024 * 1024;
+
+		// zlib takes the length of the input as a 32-bit number
+		static const std::size_t MaxBlockSize = 1024 * 1024 * 1024;
+
+		ParallelCompressor(
+			unsigned numOfThreads = 0,
+			std::size_t memoryLimit = SpoolStream::Unlimited
+		) :
+			_numOfThreads(numOfThreads),
+			_memoryLimit(memoryLimit),
+			_splitSize(0),
+			_blockSize(DefaultBlockSize)
+		{}
+
+		// sets how many bytes of each compressed entry are kept in memory,
+		// the rest is spooled to a temporary file
+		void setMemoryLimit(std::size_t memoryLimit)
+		{
+			_memoryLimit = memoryLimit;
+		}
+
+		// Once splitSize bytes of an entry have been deflated, the rest is read
+		// in blocks of blockSize bytes that are deflated on all threads, each block
+		// primed with the end of the previous one, and the raw deflate streams
+		// are joined. Zero splitSize turns the splitting off (the default),
+		// blockSize is limited to MaxBlockSize.
+		void setBlockSplitting(
+			std::size_t splitSize,
+			std::size_t blockSize = DefaultBlockSize
+		)
+		{
+			_splitSize = splitSize;
+
+			if (blockSize == 0) {
+				_blockSize = DefaultBlockSize;
+			}
+			else if (blockSize > MaxBlockSize) {
+				_blockSize = MaxBlockSize;
+			}
+			else {
+				_blockSize = blockSize;
+			}
+		}
+
+		void operator() (ZipHandle& handle)
+		{
+			// automatic policies have to be resolved before compressing
+			handle.resolveCompression();
+
+			ZipHandle::PendingEntryList pendingEntries;
+
+			for (auto& entry : handle.getPendingEntries()) {
+
+				// other methods are left to libzip
+				if (
+					entry.compression.getMethod() == ZIP_CM_DEFAULT ||
+					entry.compression.getMethod() == ZIP_CM_DEFLATE
+				) {
+					pendingEntries.push_back(entry);
+				}
+
+			}
+
+			if (pendingEntries.empty()) {
+				return;
+			}
+
+			std::vector<Job> jobs(pendingEntries.size());
+
+			ThreadPool pool(_numOfThreads);
+
+			try {
+
+				pool.forEach(
+					pendingEntries.size(),
+					[this, &pendingEntries, &jobs](std::size_t i)
+					{
+						jobs[i].entry = pendingEntries[i];
+						compress(jobs[i]);
+					}
+				);
+
+				// huge entries continue on all threads one after another
+				for (auto& job : jobs) {
+					if (job.isSplit) {
+						compressInBlocks(job, pool);
+					}
+				}
+
+			}
+			catch (...) {
+
+				for (auto& job : jobs) {
+					if (job.isSplit) {
+						call(job.entry, nullptr, 0, ZIP_SOURCE_CLOSE);
+					}
+				}
+
+				// the other sources start over when they are opened again
+				for (auto& job : jobs) {
+					if (job.source) {
+						try {
+							attachSource(handle, job);
+						}
+						catch (...) {
+							// the original source is saved instead
+						}
+					}
+				}
+
+				throw;
+			}
+
+			// attaching sources modifies the archive, so it is done serially
+			for (auto& job : jobs) {
+				attachSource(handle, job);
+			}
+		}
+
+	private:
+
+		// size of the deflate window and so of the dictionary of a block
+		static const std::size_t WindowSize = 32 * 1024;
+
+		// state of compressing one entry
+		struct Job {
+
+			Job() :
+				level(Z_BEST_COMPRESSION),
+				crc(0),
+				size(0),
+				isSplit(false)
+			{}
+
+			ZipHandle::PendingEntry entry;
+			zip_stat_t srcStat;
+			SpoolStream::SharedPtr rawData;
+			SpoolStream::SharedPtr compressedData;
+			int level;
+			uLong crc;
+			zip_uint64_t size;
+			// the last WindowSize bytes of data when splitting
+			std::vector<char> window;
+			// the rest of the data has to be deflated in blocks
+			bool isSplit;
+			PreparedSourceStream::SharedPtr source;
+
+		};
+
+		struct Block {
+			std::vector<char> input;
+			std::vector<char> output;
+			uLong crc;
+		};
+
+		unsigned _numOfThreads;
+		std::size_t _memoryLimit;
+		std::size_t _splitSize;
+		std::size_t _blockSize;
+
+		// general purpose bit flags describing the deflate level
+		static zip_uint16_t deflateFlags(int level)
+		{
+			if (level < 3) {
+				return 2 << 1; // fast
+			}
+
+			if (level > 7) {
+				return 1 << 1; // maximum
+			}
+
+			return 0; // normal
+		}
+
+		static void attachSource(ZipHandle& handle, const Job& job)
+		{
+			handle.replaceEntrySource(
+				job.entry.index,
+				&PreparedSourceStream::dispatch,
+				job.source
+			);
+		}
+
+		static zip_int64_t call(
+			const ZipHandle::PendingEntry& entry,
+			void *data,
+			zip_uint64_t len,
+			zip_source_cmd_t cmd
+		)
+		{
+			return entry.callback(entry.source.get(), data, len, cmd);
+		}
+
+		void compress(Job& job)
+		{
+			const ZipHandle::PendingEntry& entry = job.entry;
+
+			zip_stat_init(&job.srcStat);
+
+			if (call(entry, &job.srcStat, sizeof(job.srcStat), ZIP_SOURCE_STAT) < 0) {
+				throw std::runtime_error(
+					"cannot get information about archive entry data"
+				);
+			}
+
+			if (call(entry, nullptr, 0, ZIP_SOURCE_OPEN) < 0) {
+				throw std::runtime_error(
+					"cannot open archive entry data for compression"
+				);
+			}
+
+			job.rawData = std::make_shared<SpoolStream>(_memoryLimit);
+			job.compressedData = std::make_shared<SpoolStream>(_memoryLimit);
+
+			job.level = (int) entry.compression.getLevel();
+
+			if (job.level < 1 || job.level > 9) {
+				job.level = Z_BEST_COMPRESSION;
+			}
+
+			z_stream zs = z_stream();
+
+			// the parameters libzip's deflate algorithm uses
+			if (deflateInit2(&zs, job.level, Z_DEFLATED, -MAX_WBITS, MAX_MEM_LEVEL, Z_DEFAULT_STRATEGY) != Z_OK) {
+				call(entry, nullptr, 0, ZIP_SOURCE_CLOSE);
+				throw std::runtime_error("cannot initialize deflate stream");
+			}
+
+			std::vector<char> inBuf(64 * 1024);
+			std::vector<char> outBuf(64 * 1024);
+
+			job.crc = 0;
+			job.size = 0;
+
+			int zret = Z_OK;
+
+			try {
+
+				for (;;) {
+
+					zip_int64_t nread = call(
+						entry,
+						inBuf.data(),
+						inBuf.size(),
+						ZIP_SOURCE_READ
+					);
+
+					if (nread < 0) {
+						throw std::runtime_error(
+							"cannot read archive entry data for compression"
+						);
+					}
+
+					int flush = nread == 0 ? Z_FINISH : Z_NO_FLUSH;
+
+					if (
+						_splitSize > 0 &&
+						nread > 0 &&
+						job.size + nread >= _splitSize &&
+						job.size + nread > LibzipBufferSize
+					) {
+						// end on a byte boundary, so the blocks can follow
+						flush = Z_SYNC_FLUSH;
+						job.isSplit = true;
+					}
+
+					job.crc = Crc32::update((std::uint32_t) job.crc, inBuf.data(), (std::size_t) nread);
+
+					if (job.size < LibzipBufferSize) {
+						// keep the beginning in case the entry ends up being stored
+						job.rawData->write(inBuf.data(), nread);
+					}
+
+					if (_splitSize > 0) {
+						appendToWindow(job.window, inBuf.data(), (std::size_t) nread);
+					}
+
+					job.size += nread;
+
+					zs.next_in = reinterpret_cast<Bytef*>(inBuf.data());
+					zs.avail_in = (uInt) nread;
+
+					do {
+
+						zs.next_out = reinterpret_cast<Bytef*>(outBuf.data());
+						zs.avail_out = (uInt) outBuf.size();
+
+						zret = deflate(&zs, flush);
+
+						if (zret == Z_STREAM_ERROR) {
+							throw std::runtime_error("cannot deflate archive entry data");
+						}
+
+						job.compressedData->write(
+							outBuf.data(),
+							outBuf.size() - zs.avail_out
+						);
+
+					} while (zs.avail_out == 0);
+
+					if (job.compressedData->fail()) {
+						throw std::runtime_error("cannot store compressed archive entry data");
+					}
+
+					if (flush != Z_NO_FLUSH) {
+						break;
+					}
+
+				}
+
+			}
+			catch (...) {
+				deflateEnd(&zs);
+				job.isSplit = false;
+				call(entry, nullptr, 0, ZIP_SOURCE_CLOSE);
+				throw;
+			}
+
+			deflateEnd(&zs);
+
+			if (job.isSplit) {
+				// the source stays open for compressInBlocks
+				return;
+			}
+
+			call(entry, nullptr, 0, ZIP_SOURCE_CLOSE);
+
+			job.source = makeSource(job);
+		}
+
+		// deflates the rest of the entry data in blocks on all threads of the pool
+		void compressInBlocks(Job& job, ThreadPool& pool)
+		{
+			// blocks are read while none is being compressed,
+			// so there are twice as many as threads
+			std::vector<Block> blocks(2 * pool.size());
+
+			bool isLast = false;
+
+			while (!isLast) {
+
+				std::size_t numOfBlocks = 0;
+
+				while (numOfBlocks < blocks.size() && !isLast) {
+					isLast = readBlock(job.entry, blocks[numOfBlocks++].input);
+				}
+
+				pool.forEach(
+					numOfBlocks,
+					[&job, &blocks, numOfBlocks, isLast](std::size_t i)
+					{
+						deflateBlock(
+							blocks[i],
+							i == 0 ? job.window : blocks[i - 1].input,
+							job.level,
+							isLast && i + 1 == numOfBlocks
+						);
+					}
+				);
+
+				for (std::size_t i = 0; i < numOfBlocks; i++) {
+
+					Block& block = blocks[i];
+
+					job.compressedData->write(block.output.data(), block.output.size());
+
+					job.crc = crc32_combine(job.crc, block.crc, (z_off_t) block.input.size());
+					job.size += block.input.size();
+
+					appendToWindow(job.window, block.input.data(), block.input.size());
+
+				}
+
+				if (job.compressedData->fail()) {
+					throw std::runtime_error("cannot store compressed archive entry data");
+				}
+
+			}
+
+			job.isSplit = false;
+			call(job.entry, nullptr, 0, ZIP_SOURCE_CLOSE);
+
+			job.source = makeSource(job);
+		}
+
+		// fills the buffer with up to a block of data, returns true at the end of the data
+		bool readBlock(const ZipHandle::PendingEntry& entry, std::vector<char>& input)
+		{
+			input.resize(_blockSize);
+
+			std::size_t len = 0;
+
+			while (len < input.size()) {
+
+				zip_int64_t nread = call(
+					entry,
+					input.data() + len,
+					input.size() - len,
+					ZIP_SOURCE_READ
+				);
+
+				if (nread < 0) {
+					throw std::runtime_error(
+						"cannot read archive entry data for compression"
+					);
+				}
+
+				if (nread == 0) {
+					input.resize(len);
+					return true;
+				}
+
+				len += (std::size_t) nread;
+
+			}
+
+			return false;
+		}
+
+		// deflates the block as a part of a raw deflate stream that follows
+		// the dictionary, the last block finishes the stream
+		static void deflateBlock(
+			Block& block,
+			const std::vector<char>& dictionary,
+			int level,
+			bool isLast
+		)
+		{
+			Bytef* input = reinterpret_cast<Bytef*>(block.input.data());
+
+			block.crc = Crc32::update(0, input, block.input.size());
+
+			z_stream zs = z_stream();
+
+			if (deflateInit2(&zs, level, Z_DEFLATED, -MAX_WBITS, MAX_MEM_LEVEL, Z_DEFAULT_STRATEGY) != Z_OK) {
+				throw std::runtime_error("cannot initialize deflate stream");
+			}
+
+			if (!dictionary.empty()) {
+
+				// only the last WindowSize bytes are used
+				deflateSetDictionary(
+					&zs,
+					reinterpret_cast<const Bytef*>(dictionary.data()),
+					(uInt) dictionary.size()
+				);
+
+			}
+
+			block.output.resize(deflateBound(&zs, (uLong) block.input.size()) + 16);
+
+			zs.next_in = input;
+			zs.avail_in = (uInt) block.input.size();
+
+			std::size_t nout = 0;
+			int zret = Z_OK;
+
+			do {
+
+				if (nout == block.output.size()) {
+					block.output.resize(2 * block.output.size());
+				}
+
+				zs.next_out = reinterpret_cast<Bytef*>(block.output.data() + nout);
+				zs.avail_out = (uInt) (block.output.size() - nout);
+
+				zret = deflate(&zs, isLast ? Z_FINISH : Z_SYNC_FLUSH);
+
+				nout = block.output.size() - zs.avail_out;
+
+			} while (zret != Z_STREAM_ERROR && zs.avail_out == 0);
+
+			deflateEnd(&zs);
+
+			if (zret == Z_STREAM_ERROR) {
+				throw std::runtime_error("cannot deflate archive entry data");
+			}
+
+			block.output.resize(nout);
+		}
+
+		// keeps the last WindowSize bytes of the data
+		static void appendToWindow(std::vector<char>& window, const char* data, std::size_t len)
+		{
+			if (len >= WindowSize) {
+				window.assign(data + len - WindowSize, data + len);
+				return;
+			}
+
+			window.insert(window.end(), data, data + len);
+
+			if (window.size() > WindowSize) {
+				window.erase(window.begin(), window.end() - WindowSize);
+			}
+		}
+
+		PreparedSourceStream::SharedPtr makeSource(const Job& job)
+		{
+			const zip_stat_t& srcStat = job.srcStat;
+
+			// libzip stores small incompressible data only for the default method
+			bool canStore = job.entry.compression.getMethod() == ZIP_CM_DEFAULT;
+
+			zip_file_attributes_t attributes;
+			zip_file_attributes_init(&attributes);
+
+			zip_stat_t initialStat = srcStat;
+			initialStat.valid &= ZIP_STAT_SIZE | ZIP_STAT_MTIME;
+
+			zip_stat_t finalStat = initialStat;
+
+			if (
+				canStore &&
+				job.size <= LibzipBufferSize &&
+				job.compressedData->size() >= job.size
+			) {
+
+				// libzip stores small entries that do not shrink,
+				// so hand over the raw data and let it decide
+				return std::make_shared<PreparedSourceStream>(
+					job.rawData,
+					initialStat,
+					finalStat,
+					attributes
+				);
+			}
+
+			initialStat.valid |= ZIP_STAT_COMP_METHOD;
+			initialStat.comp_method = ZIP_CM_DEFLATE;
+
+			finalStat = initialStat;
+			finalStat.valid |= ZIP_STAT_SIZE | ZIP_STAT_COMP_SIZE | ZIP_STAT_CRC;
+			finalStat.size = job.size;
+			finalStat.comp_size = job.compressedData->size();
+			finalStat.crc = (zip_uint32_t) job.crc;
+
+			// the attributes libzip's deflate algorithm reports
+			attributes.valid |= ZIP_FILE_ATTRIBUTES_VERSION_NEEDED
+				| ZIP_FILE_ATTRIBUTES_GENERAL_PURPOSE_BIT_FLAGS;
+			attributes.version_needed = 20;
+			attributes.general_purpose_bit_flags = deflateFlags(job.level);
+			attributes.general_purpose_bit_mask = 0x0836;
+
+			return std::make_shared<PreparedSourceStream>(
+				job.compressedData,
+				initialStat,
+				finalStat,
+				attributes
+			);
+		}
+
+	};
+
+}
+}
@@ -0,0 +1,454 @@
+#pragma once
+
+#include "InputArchiveStream.h"
+
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <ios>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace Zip {
+inline namespace ZIPCPP_METRICS_NAMESPACE {
+
+	// This class wraps an input stream with a high latency (network file systems,
+	// pipes, ...) and reads ahead of the current position on a background thread.
+	// Reads go straight to the input stream until two reads follow each other,
+	// from then on the stream is read in large blocks kept in a bounded queue
+	// and reads are served from memory. Seeking within the queued blocks keeps
+	// them, other seeks stop reading ahead until the access is sequential again.
+	// The class behaves like std::istream for SeekableSourceStream, it must not
+	// be used from more threads at once.
+
+	template<typename InputStream>
+	class PrefetchInputStream {
+	public:
+
+		typedef std::shared_ptr<PrefetchInputStream> SharedPtr;
+
+		static const std::ios_base::seekdir beg = std::ios_base::beg;
+		static const std::ios_base::seekdir cur = std::ios_base::cur;
+		static const std::ios_base::seekdir end = std::ios_base::end;
+
+		static const std::size_t DefaultBlockSize = 256 * 1024;
+		static const std::size_t DefaultNumOfBlocks = 4;
+
+		PrefetchInputStream(
+			InputStream inputStreamPtr,
+			std::size_t blockSize = DefaultBlockSize,
+			std::size_t numOfBlocks = DefaultNumOfBlocks
+		) :
+			_inputStreamPtr(inputStreamPtr),
+			_blockSize(blockSize > 0 ? blockSize : DefaultBlockSize),
+			_numOfBlocks(numOfBlocks > 0 ? numOfBlocks : 1),
+			_pos(inputStreamPtr->tellg()),
+			_inputPos(_pos),
+			_sequentialEnd(-1),
+			_gcount(0),
+			_failFlag(_pos < 0),
+			_eofFlag(false),
+			_isPrefetching(false),
+			_isReading(false),
+			_inputEnd(false),
+			_inputFailed(false),
+			_stop(false)
+		{}
+
+		~PrefetchInputStream()
+		{
+			if (_worker.joinable()) {
+
+				{
+					std::lock_guard<std::mutex> lock(_mutex);
+					_stop = true;
+				}
+
+				_changed.notify_all();
+				_worker.join();
+
+			}
+		}
+
+		PrefetchInputStream(const PrefetchInputStream&) = delete;
+		PrefetchInputStream& operator= (const PrefetchInputStream&) = delete;
+
+		long long gcount() const { return _gcount; }
+		bool fail() const { return _failFlag; }
+		bool eof() const { return _eofFlag; }
+
+		void clear()
+		{
+			_failFlag = false;
+			_eofFlag = false;
+		}
+
+		long long tellg()
+		{
+			return _failFlag ? -1 : _pos;
+		}
+
+		void seekg(long long off, std::ios_base::seekdir dir)
+		{
+			_eofFlag = false;
+
+			if (_failFlag) {
+				return;
+			}
+
+			if (dir == end) {
+
+				// the size is known only to the input stream
+				stopPrefetching();
+
+				_inputStreamPtr->clear();
+				_inputStreamPtr->seekg(off, end);
+
+				_inputPos = _inputStreamPtr->fail() ? -1 : (long long) _inputStreamPtr->tellg();
+
+				if (_inputPos < 0) {
+					_failFlag = true;
+					return;
+				}
+
+				_pos = _inputPos;
+				return;
+			}
+
+			long long target = dir == cur ? _pos + off : off;
+
+			if (target < 0) {
+				_failFlag = true;
+				return;
+			}
+
+			if (_isPrefetching && skipTo(target)) {
+				return;
+			}
+
+			stopPrefetching();
+
+			if (!seekInput(target)) {
+				_failFlag = true;
+				return;
+			}
+
+			_pos = target;
+		}
+
+		void read(char* buff, long long len)
+		{
+			_gcount = 0;
+
+			if (_failFlag || len <= 0) {
+				return;
+			}
+
+			if (!_isPrefetching && _pos == _sequentialEnd) {
+				// the previous read ended here, so more will probably follow
+				startPrefetching();
+			}
+
+			if (_isPrefetching) {
+				readPrefetched(buff, (std::size_t) len);
+			}
+			else {
+				readDirectly(buff, (std::size_t) len);
+			}
+
+			_sequentialEnd = _pos;
+		}
+
+	private:
+
+		struct Block {
+			long long offset;
+			std::vector<char> data;
+		};
+
+		InputStream _inputStreamPtr;
+		std::size_t _blockSize;
+		std::size_t _numOfBlocks;
+
+		// position of the next read from this stream
+		long long _pos;
+		// position of the input stream, or of the next block when reading ahead
+		long long _inputPos;
+		long long _sequentialEnd;
+		long long _gcount;
+		bool _failFlag;
+		bool _eofFlag;
+
+		// shared with the worker thread
+		std::thread _worker;
+		std::mutex _mutex;
+		std::condition_variable _changed;
+		std::deque<Block> _blocks;
+		std::vector<std::vector<char>> _freeBuffers;
+		bool _isPrefetching;
+		bool _isReading;
+		bool _inputEnd;
+		bool _inputFailed;
+		bool _stop;
+
+		bool seekInput(long long target)
+		{
+			if (_inputPos == target) {
+				return true;
+			}
+
+			_inputStreamPtr->clear();
+			_inputStreamPtr->seekg(target, beg);
+
+			if (_inputStreamPtr->fail()) {
+				_inputPos = -1;
+				return false;
+			}
+
+			_inputPos = target;
+			return true;
+		}
+
+		void readDirectly(char* buff, std::size_t len)
+		{
+			if (!seekInput(_pos)) {
+				_failFlag = true;
+				return;
+			}
+
+			_inputStreamPtr->read(buff, len);
+
+			_gcount = (long long) _inputStreamPtr->gcount();
+			_pos += _gcount;
+			_inputPos += _gcount;
+
+			if (_inputStreamPtr->fail()) {
+				_failFlag = true;
+				_eofFlag = _inputStreamPtr->eof();
+			}
+		}
+
+		void readPrefetched(char* buff, std::size_t len)
+		{
+			std::unique_lock<std::mutex> lock(_mutex);
+
+			std::size_t ncopied = 0;
+
+			while (ncopied < len) {
+
+				_changed.wait(lock, [this]()
+				{
+					return !_blocks.empty() || _inputEnd || _inputFailed;
+				});
+
+				if (_blocks.empty()) {
+					_failFlag = true;
+					_eofFlag = !_inputFailed;
+					break;
+				}
+
+				Block& block = _blocks.front();
+
+				std::size_t offset = (std::size_t) (_pos - block.offset);
+				std::size_t avail = block.data.size() - offset;
+				std::size_t ncopy = avail < len - ncopied ? avail : len - ncopied;
+
+				std::memcpy(buff + ncopied, block.data.data() + offset, ncopy);
+
+				ncopied += ncopy;
+				_pos += ncopy;
+
+				if (ncopy == avail) {
+					releaseFrontBlock();
+				}
+
+			}
+
+			_gcount = (long long) ncopied;
+		}
+
+		// moves within the queued blocks, returns false
+		// if the target is not there
+		bool skipTo(long long target)
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+
+			if (_blocks.empty() ? target < _pos : target < _blocks.front().offset) {
+				return false;
+			}
+
+			while (!_blocks.empty()) {
+
+				Block& block = _blocks.front();
+
+				if (target < block.offset + (long long) block.data.size()) {
+					_pos = target;
+					return true;
+				}
+
+				releaseFrontBlock();
+
+			}
+
+			// everything queued has been skipped, the next block may still be fine
+			if (target == _inputPos && !_inputEnd && !_inputFailed) {
+				_pos = target;
+				return true;
+			}
+
+			return false;
+		}
+
+		void releaseFrontBlock()
+		{
+			_freeBuffers.push_back(std::move(_blocks.front().data));
+			_blocks.pop_front();
+			_changed.notify_all();
+		}
+
+		void startPrefetching()
+		{
+			if (!seekInput(_pos)) {
+				return;
+			}
+
+			{
+				std::lock_guard<std::mutex> lock(_mutex);
+
+				_isPrefetching = true;
+				_inputEnd = false;
+				_inputFailed = false;
+			}
+
+			if (!_worker.joinable()) {
+				_worker = std::thread(&PrefetchInputStream::prefetch, this);
+			}
+			else {
+				_changed.notify_all();
+			}
+		}
+
+		// gives the input stream back to the calling thread
+		void stopPrefetching()
+		{
+			std::unique_lock<std::mutex> lock(_mutex);
+
+			if (!_isPrefetching) {
+				return;
+			}
+
+			_isPrefetching = false;
+
+			_changed.wait(lock, [this]()
+			{
+				return !_isReading;
+			});
+
+			while (!_blocks.empty()) {
+				_freeBuffers.push_back(std::move(_blocks.front().data));
+				_blocks.pop_front();
+			}
+
+			// the input stream is positioned after the last block read
+			if (_inputFailed) {
+				_inputPos = -1;
+			}
+		}
+
+		// body of the worker thread
+		void prefetch()
+		{
+			std::unique_lock<std::mutex> lock(_mutex);
+
+			while (true) {
+
+				_changed.wait(lock, [this]()
+				{
+					return _stop || (
+						_isPrefetching &&
+						!_inputEnd &&
+						!_inputFailed &&
+						_blocks.size() < _numOfBlocks
+					);
+				});
+
+				if (_stop) {
+					return;
+				}
+
+				std::vector<char> data;
+
+				if (!_freeBuffers.empty()) {
+					data = std::move(_freeBuffers.back());
+					_freeBuffers.pop_back();
+				}
+
+				long long offset = _inputPos;
+
+				_isReading = true;
+				lock.unlock();
+
+				long long nread = 0;
+				bool failed = false;
+				bool ended = false;
+
+				try {
+
+					data.resize(_blockSize);
+
+					_inputStreamPtr->read(data.data(), _blockSize);
+
+					nread = (long long) _inputStreamPtr->gcount();
+
+					if (_inputStreamPtr->fail()) {
+						ended = _inputStreamPtr->eof();
+						failed = !ended;
+					}
+
+				}
+				catch (...) {
+					failed = true;
+				}
+
+				lock.lock();
+				_isReading = false;
+
+				data.resize((std::size_t) nread);
+
+				if (nread > 0) {
+					_blocks.push_back(Block { offset, std::move(data) });
+					_inputPos += nread;
+				}
+
+				_inputEnd = ended;
+				_inputFailed = failed;
+
+				_changed.notify_all();
+
+			}
+		}
+
+	};
+
+	// Creates an instance of input archive that reads ahead of libzip
+	// in blocks of blockSize bytes on a background thread.
+	template<typename InputStream>
+	Archive MakePrefetchInputArchive(
+		InputStream inputStream,
+		std::size_t blockSize = PrefetchInputStream<InputStream>::DefaultBlockSize,
+		std::size_t numOfBlocks = PrefetchInputStream<InputStream>::DefaultNumOfBlocks
+	)
+	{
+		return MakeInputArchive(
+			std::make_shared<PrefetchInputStream<InputStream>>(
+				inputStream,
+				blockSize,
+				numOfBlocks
+			)
+		);
+	}
+
+}
+}
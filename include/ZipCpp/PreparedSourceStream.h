@@ -0,0 +1,98 @@
+#pragma once
+
+#include "ReadableSourceStream.h"
+#include "SpoolStream.h"
+
+#define ZIP_PREPARED_SOURCE_STREAM_SUPPORTS \
+	ZIP_SOURCE_SUPPORTS, \
+	ZIP_SOURCE_GET_FILE_ATTRIBUTES
+
+namespace Zip {
+inline namespace ZIPCPP_METRICS_NAMESPACE {
+
+	// This class serves entry data that has been prepared in advance,
+	// typically already compressed, so that libzip only copies it to the archive.
+	// Until the data has been read to the end, stat reports only the fields
+	// the original source announced, the rest is reported afterwards,
+	// which is also how libzip's own compression layer behaves.
+
+	class PreparedSourceStream : public ReadableSourceStream<SpoolStream::SharedPtr> {
+	public:
+
+		typedef std::shared_ptr<PreparedSourceStream> SharedPtr;
+
+		static const bool HasFileAttributes = true;
+
+		static zip_int64_t dispatch(
+			void *userdata,
+			void *data,
+			zip_uint64_t len,
+			zip_source_cmd_t cmd
+		)
+		{
+			return SourceDispatcher<PreparedSourceStream>::dispatch(userdata, data, len, cmd);
+		}
+
+		PreparedSourceStream(
+			SpoolStream::SharedPtr data,
+			const zip_stat_t& initialStat,
+			const zip_stat_t& finalStat,
+			const zip_file_attributes_t& attributes
+		) :
+			ReadableSourceStream<SpoolStream::SharedPtr>(data),
+			_initialStat(initialStat),
+			_finalStat(finalStat),
+			_attributes(attributes)
+		{}
+
+	protected:
+
+		template<typename> friend class SourceDispatcher;
+
+		virtual zip_int64_t open()
+		{
+			_inputStreamPtr->rewind();
+			return 0;
+		}
+
+		virtual zip_int64_t stat(zip_stat_t* zipStatPtr)
+		{
+			*zipStatPtr = _inputStreamPtr->eof() ? _finalStat : _initialStat;
+			return 0;
+		}
+
+		virtual zip_int64_t getFileAttributes(void *data, zip_uint64_t len)
+		{
+			if (len < sizeof(zip_file_attributes_t)) {
+				_lastError.setCode(ZIP_ER_INVAL);
+				return -1;
+			}
+
+			zip_file_attributes_t* attributes = reinterpret_cast<
+				zip_file_attributes_t*
+			>(data);
+
+			if (_attributes.valid & ZIP_FILE_ATTRIBUTES_VERSION_NEEDED) {
+				attributes->version_needed = _attributes.version_needed;
+			}
+
+			if (_attributes.valid & ZIP_FILE_ATTRIBUTES_GENERAL_PURPOSE_BIT_FLAGS) {
+				attributes->general_purpose_bit_flags = _attributes.general_purpose_bit_flags;
+				attributes->general_purpose_bit_mask = _attributes.general_purpose_bit_mask;
+			}
+
+			attributes->valid |= _attributes.valid;
+
+			return sizeof(zip_file_attributes_t);
+		}
+
+	private:
+
+		zip_stat_t _initialStat;
+		zip_stat_t _finalStat;
+		zip_file_attributes_t _attributes;
+
+	};
+
+}
+}
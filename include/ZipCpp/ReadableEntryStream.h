@@ -1,10 +1,16 @@
 #pragma once
 
 #include "ZipHandle.h"
+#include "BufferPool.h"
+#include "Crc32.h"
+#include "EntryDecoder.h"
 
+#include <cstdio>
 #include <functional>
+#include <ios>
 
 namespace Zip {
+inline namespace ZIPCPP_METRICS_NAMESPACE {
 
 	class ReadableEntryStream {
 	public:
@@ -13,16 +19,38 @@ namespace Zip {
 		typedef std::weak_ptr<ReadableEntryStream> WeakPtr;
 	
 		typedef std::function<void(ZipFileHandle::WeakPtr)> Deleter;
+		typedef std::function<ZipFileHandle::WeakPtr()> Reopener;
 
+		// size of skipped data read at once when the stream cannot seek directly
+		static const std::size_t SkipBufferSize = 64 * 1024;
+
+		// reopen is used to return to the beginning of the entry,
+		// size is the uncompressed size or -1 if it is unknown,
+		// seekable entries are positioned by libzip without reading,
+		// expectedCrc is checked at the end of the entry unless it is -1,
+		// a decoder decodes and positions the raw data of the entry
 		ReadableEntryStream(
 			ZipFileHandle::WeakPtr fileHandle,
-			Deleter deleter
+			Deleter deleter,
+			Reopener reopen = nullptr,
+			zip_int64_t size = -1,
+			bool isSeekable = false,
+			zip_int64_t expectedCrc = -1,
+			EntryDecoder::SharedPtr decoder = nullptr
 		) :
 			_fileHandle(fileHandle),
 			_deleter(deleter),
+			_reopen(reopen),
+			_size(size),
+			_isSeekable(isSeekable),
+			_expectedCrc(expectedCrc),
+			_decoder(decoder),
 			_eof(false),
 			_fail(false),
-			_nread(0)
+			_nread(0),
+			_pos(0),
+			_crc(0),
+			_crcPos(0)
 		{}
 
 		~ReadableEntryStream()
@@ -35,6 +63,94 @@ namespace Zip {
 		bool good() { return !_eof && !_fail; }
 		size_t gcount() { return _nread; }
 
+		// returns the current position in the entry data or -1 on failure
+		zip_int64_t tellg()
+		{
+			return _fail ? -1 : (zip_int64_t) _pos;
+		}
+
+		// Moves to the given position. Stored entries are positioned directly,
+		// entries with a decoder are positioned by it, others are read forward
+		// from the current position, or from the beginning of the entry
+		// when moving backwards.
+		ReadableEntryStream& seekg(
+			zip_int64_t offset,
+			std::ios_base::seekdir dir = std::ios_base::beg
+		)
+		{
+			_nread = 0;
+
+			if (_fail) {
+				return *this;
+			}
+
+			zip_int64_t target = offset;
+
+			if (dir == std::ios_base::cur) {
+				target += (zip_int64_t) _pos;
+			}
+			else if (dir == std::ios_base::end) {
+
+				if (_size < 0) {
+					_fail = true;
+					return *this;
+				}
+
+				target += _size;
+			}
+
+			if (target < 0 || (_size >= 0 && target > _size)) {
+				_fail = true;
+				return *this;
+			}
+
+			_eof = false;
+
+			if ((zip_uint64_t) target == _pos) {
+				return *this;
+			}
+
+			auto tempFileHandle = _fileHandle.lock();
+
+			if (!tempFileHandle) {
+				// archive has been destroyed
+				_fail = true;
+				return *this;
+			}
+
+			if (_decoder) {
+
+				if (!_decoder->seek(*tempFileHandle, (zip_uint64_t) target)) {
+					_fail = true;
+					return *this;
+				}
+
+				_pos = (zip_uint64_t) target;
+				return *this;
+			}
+
+			if (_isSeekable && tempFileHandle->seek(target, SEEK_SET) == 0) {
+				_pos = (zip_uint64_t) target;
+				return *this;
+			}
+
+			// a failed seek leaves the file in an error state
+			if ((zip_uint64_t) target < _pos || _isSeekable) {
+
+				tempFileHandle.reset();
+
+				if (!rewind()) {
+					_fail = true;
+					return *this;
+				}
+
+			}
+
+			skip((zip_uint64_t) target - _pos);
+
+			return *this;
+		}
+
 		ZipFileHandle::WeakPtr getFileHandle()
 		{
 			return _fileHandle;
@@ -62,7 +178,9 @@ namespace Zip {
 				return;
 			}
 
-			auto nread = tempFileHandle->read(buf, nbytes);
+			auto nread = _decoder
+				? _decoder->read(*tempFileHandle, buf, nbytes)
+				: tempFileHandle->read(buf, nbytes);
 
 			if (nread < 0) {
 				// failed to read data
@@ -72,6 +190,16 @@ namespace Zip {
 
 			_nread = (size_t) nread;
 
+			if (_expectedCrc >= 0 && !updateCrc(buf)) {
+				// the data does not match the archive
+				_fail = true;
+				return;
+			}
+
+			_pos += _nread;
+
+			Metrics::addCount(MetricId::EntryReadBytes, _nread);
+
 			if (_nread == 0) {
 				// end of file
 				_eof = true;
@@ -83,11 +211,96 @@ namespace Zip {
 
 		ZipFileHandle::WeakPtr _fileHandle;
 		Deleter _deleter;
+		Reopener _reopen;
+		zip_int64_t _size;
+		bool _isSeekable;
+		zip_int64_t _expectedCrc;
+		EntryDecoder::SharedPtr _decoder;
 
 		bool _eof;
 		bool _fail;
 		size_t _nread;
+		zip_uint64_t _pos;
+
+		// crc of the data read in sequence from the beginning up to _crcPos
+		std::uint32_t _crc;
+		zip_uint64_t _crcPos;
+
+		// Continues the crc with the data just read, returns false
+		// when the end of the entry is reached and the crc does not match.
+		// Data read after seeking forward is not checked.
+		bool updateCrc(const char* buf)
+		{
+			if (_pos == 0) {
+				// read from the beginning once more after rewinding
+				_crc = 0;
+				_crcPos = 0;
+			}
+
+			if (_pos != _crcPos) {
+				return true;
+			}
+
+			if (_nread > 0) {
+				_crc = Crc32::update(_crc, buf, _nread);
+				_crcPos += _nread;
+				return true;
+			}
+
+			return (_size < 0 || _crcPos == (zip_uint64_t) _size)
+				&& _crc == (std::uint32_t) _expectedCrc;
+		}
+
+		// reopens the entry at the beginning
+		bool rewind()
+		{
+			if (!_reopen) {
+				return false;
+			}
+
+			_deleter(_fileHandle);
+			_fileHandle.reset();
+			_pos = 0;
+
+			try {
+				_fileHandle = _reopen();
+			}
+			catch (...) {
+				return false;
+			}
+
+			return !_fileHandle.expired();
+		}
+
+		// reads and drops the given number of bytes
+		void skip(zip_uint64_t nbytes)
+		{
+			auto tempFileHandle = _fileHandle.lock();
+
+			if (!tempFileHandle) {
+				_fail = true;
+				return;
+			}
+
+			auto buf = BufferPool::acquire(SkipBufferSize);
+
+			while (nbytes > 0) {
+
+				zip_uint64_t len = nbytes < buf.size() ? nbytes : buf.size();
+				zip_int64_t nread = tempFileHandle->read(buf.data(), len);
+
+				if (nread <= 0) {
+					// failed or the entry is shorter than expected
+					_fail = true;
+					return;
+				}
+
+				_pos += (zip_uint64_t) nread;
+				nbytes -= (zip_uint64_t) nread;
+			}
+		}
 
 	};
 
+}
 }
\ No newline at end of file
@@ -1,10 +1,16 @@
 #pragma once
 
 #include "SourceStream.h"
+#include "Error.h"
+#include "SourceDispatcher.h"
 
 #include <zipconf.h>
 #include <zip.h>
 
+#include <algorithm>
+#include <ios>
+#include <vector>
+
 #define ZIP_READABLE_SOURCE_STREAM_SUPPORTS \
 	ZIP_SOURCE_OPEN, \
 	ZIP_SOURCE_READ, \
@@ -14,11 +20,16 @@
 	ZIP_SOURCE_FREE
 
 namespace Zip {
+inline namespace ZIPCPP_METRICS_NAMESPACE {
 
 	template<typename InputStream>
 	class ReadableSourceStream : public SourceStream {
 	public:
 
+		static const bool IsSeekable = false;
+		static const bool IsWritable = false;
+		static const bool HasFileAttributes = false;
+
 		static zip_int64_t dispatch(
 			void *userdata,
 			void *data,
@@ -26,73 +37,64 @@ namespace Zip {
 			zip_source_cmd_t cmd
 		)
 		{
-			zip_int64_t result = -1;
+			return SourceDispatcher<ReadableSourceStream>::dispatch(userdata, data, len, cmd);
+		}
 
-			ReadableSourceStream* src = reinterpret_cast<
-				ReadableSourceStream*
-			>(userdata);
+		ReadableSourceStream(InputStream inputStreamPtr) :
+			_inputStreamPtr(inputStreamPtr),
+			_startPos(tellInput(*inputStreamPtr, 0)),
+			_prefixPos(0),
+			_hasBeenRead(false)
+		{}
 
-			switch (cmd) {
+		virtual zip_int64_t peek(char* buff, zip_uint64_t len)
+		{
+			if (_hasBeenRead) {
+				// the beginning of the data has already been consumed
+				return -1;
+			}
 
-				case ZIP_SOURCE_SUPPORTS: // check whether source supports command
-					result = src->supports();
-				break;
+			if (_prefix.size() < len) {
 
-				case ZIP_SOURCE_OPEN: // prepare for reading
-					result = src->open();
-				break;
+				// read ahead the missing part and keep it for reading
+				std::size_t prefixSize = _prefix.size();
 
-				case ZIP_SOURCE_READ: // read data
-					result = src->read(
-						reinterpret_cast<char*>(data),
-						len
-					);
-				break;
+				_prefix.resize((std::size_t) len);
 
-				case ZIP_SOURCE_CLOSE: // reading is done
-					result = src->close();
-				break;
+				zip_int64_t nread = readInput(
+					_prefix.data() + prefixSize,
+					len - prefixSize
+				);
 
-				case ZIP_SOURCE_STAT: // get meta information
-					result = src->stat(
-						reinterpret_cast<zip_stat_t*>(data)
-					);
-				break;
+				_prefix.resize(prefixSize + (nread > 0 ? (std::size_t) nread : 0));
 
-				case ZIP_SOURCE_ERROR: // get error information
-					result = src->error(data, len);
-				break;
+				if (nread < 0) {
+					return -1;
+				}
 
-				case ZIP_SOURCE_FREE: // cleanup and free resources
-					result = src->free();
-				break;
+			}
 
-				default: // invalid command
-					src->_lastError.setCode(ZIP_ER_INVAL);
+			std::size_t npeek = _prefix.size() < len ? _prefix.size() : (std::size_t) len;
 
-			}
+			std::copy(_prefix.begin(), _prefix.begin() + npeek, buff);
 
-			return result;
+			return (zip_int64_t) npeek;
 		}
 
-		ReadableSourceStream(InputStream inputStreamPtr) :
-			_inputStreamPtr(inputStreamPtr)
-		{}
-
 	protected:
 
+		template<typename> friend class SourceDispatcher;
+
 		// generic pointer to the input stream
 		InputStream _inputStreamPtr;
+		// position of the beginning of the data in the input stream
+		std::streampos _startPos;
 		// stores information about the last zip error
 		Error _lastError;
-
-		virtual zip_int64_t supports()
-		{
-			return zip_source_make_command_bitmap(
-				ZIP_READABLE_SOURCE_STREAM_SUPPORTS,
-				-1
-			);
-		}
+		// data read ahead by peek that has to be read first
+		std::vector<char> _prefix;
+		std::size_t _prefixPos;
+		bool _hasBeenRead;
 
 		virtual zip_int64_t stat(zip_stat_t* zipStatPtr)
 		{
@@ -102,10 +104,108 @@ namespace Zip {
 
 		virtual zip_int64_t open()
 		{
+			// the data is read from the beginning each time it is opened,
+			// e.g. once more after a failed attempt to compress it in advance
+			if (_hasBeenRead && !rewind()) {
+				_lastError.setCode(ZIP_ER_READ);
+				return -1;
+			}
+
 			return 0;
 		}
 
+		bool rewind()
+		{
+			if (!rewindInput(*_inputStreamPtr, _startPos, 0)) {
+				return false;
+			}
+
+			_prefix.clear();
+			_prefixPos = 0;
+			_hasBeenRead = false;
+
+			return true;
+		}
+
+		// streams that move back to the beginning by themselves, like SpoolStream
+		template<typename Stream>
+		static auto rewindInput(Stream& stream, std::streampos, int)
+			-> decltype(stream.rewind(), bool())
+		{
+			stream.rewind();
+			return true;
+		}
+
+		template<typename Stream>
+		static auto rewindInput(Stream& stream, std::streampos startPos, long)
+			-> decltype(stream.seekg(std::streamoff(startPos), std::ios_base::beg), bool())
+		{
+			if (startPos == std::streampos(-1)) {
+				// the stream cannot seek
+				return false;
+			}
+
+			stream.clear();
+			stream.seekg(std::streamoff(startPos), std::ios_base::beg);
+
+			return !stream.fail();
+		}
+
+		template<typename Stream>
+		static bool rewindInput(Stream&, std::streampos, ...)
+		{
+			return false;
+		}
+
+		template<typename Stream>
+		static auto tellInput(Stream& stream, int)
+			-> decltype(std::streampos(stream.tellg()))
+		{
+			return std::streampos(stream.tellg());
+		}
+
+		template<typename Stream>
+		static std::streampos tellInput(Stream&, ...)
+		{
+			return std::streampos(-1);
+		}
+
 		virtual zip_int64_t read(char* buff, zip_uint64_t len)
+		{
+			zip_int64_t nprefix = 0;
+
+			_hasBeenRead = true;
+
+			if (_prefixPos < _prefix.size()) {
+
+				// serve the data read ahead by peek first
+				std::size_t avail = _prefix.size() - _prefixPos;
+				std::size_t ncopy = avail < len ? avail : (std::size_t) len;
+
+				std::copy(
+					_prefix.begin() + _prefixPos,
+					_prefix.begin() + _prefixPos + ncopy,
+					buff
+				);
+
+				_prefixPos += ncopy;
+
+				if (ncopy == len) {
+					return (zip_int64_t) ncopy;
+				}
+
+				nprefix = (zip_int64_t) ncopy;
+				buff += ncopy;
+				len -= ncopy;
+
+			}
+
+			zip_int64_t nread = readInput(buff, len);
+
+			return nread < 0 ? -1 : nprefix + nread;
+		}
+
+		zip_int64_t readInput(char* buff, zip_uint64_t len)
 		{
 			_inputStreamPtr->read(buff, (size_t) len);
 
@@ -139,4 +239,5 @@ namespace Zip {
 
 	};
 
+}
 }
\ No newline at end of file
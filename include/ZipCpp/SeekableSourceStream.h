@@ -8,11 +8,14 @@
 	ZIP_SOURCE_SUPPORTS
 
 namespace Zip {
+inline namespace ZIPCPP_METRICS_NAMESPACE {
 
 	template<typename InputStream>
 	class SeekableSourceStream : public ReadableSourceStream<InputStream> {
 	public:
 
+		static const bool IsSeekable = true;
+
 		static zip_int64_t dispatch(
 			void *userdata,
 			void *data,
@@ -20,34 +23,7 @@ namespace Zip {
 			zip_source_cmd_t cmd
 		)
 		{
-			zip_int64_t result = -1;
-
-			SeekableSourceStream* src = reinterpret_cast<
-				SeekableSourceStream*
-			>(userdata);
-
-			switch (cmd) {
-
-				case ZIP_SOURCE_SEEK: // set position for reading
-					result = src->seek(data, len);
-				break;
-
-				case ZIP_SOURCE_TELL: // get read position
-					result = src->tell();
-				break;
-
-				default:
-
-					result = ReadableSourceStream<InputStream>::dispatch(
-						userdata,
-						data,
-						len,
-						cmd
-					);
-
-			}
-
-			return result;
+			return SourceDispatcher<SeekableSourceStream>::dispatch(userdata, data, len, cmd);
 		}
 
 		SeekableSourceStream(InputStream inputStreamPtr) :
@@ -57,14 +33,7 @@ namespace Zip {
 
 	protected:
 
-		virtual zip_int64_t supports()
-		{
-			return zip_source_make_command_bitmap(
-				ZIP_READABLE_SOURCE_STREAM_SUPPORTS,
-				ZIP_SEEKABLE_SOURCE_STREAM_SUPPORTS,
-				-1
-			);
-		}
+		template<typename> friend class SourceDispatcher;
 
 		virtual zip_int64_t stat(zip_stat_t* zipStatPtr)
 		{
@@ -204,4 +173,5 @@ namespace Zip {
 
 	};
 
+}
 }
\ No newline at end of file
@@ -0,0 +1,509 @@
+#pragma once
+
+#include "MappedFile.h"
+
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <sys/stat.h>
+
+#ifdef _WIN32
+	#ifndef NOMINMAX
+		#define NOMINMAX
+	#endif
+	#include <windows.h>
+	#include <fcntl.h>
+	#include <io.h>
+	#include <share.h>
+#else
+	#include <fcntl.h>
+	#include <unistd.h>
+#endif
+
+// This class reads and writes a sidecar index of an immutable archive, so that
+// short-lived processes can look up entries without parsing the central
+// directory. The file is mapped into memory and used as it is:
+//
+//   header     64 bytes: "ZCPPIDX1", version, archive size, archive mtime,
+//              hash of the end of central directory, number of entries,
+//              number of slots, size of names
+//   slots      4 bytes each: record number + 1 or 0 if empty, open addressing
+//              by the hash of the name with linear probing
+//   records    56 bytes each: hash, name offset, compressed size, size,
+//              local header offset, crc, name length, method, flags
+//   names      the names of the entries one after another
+//
+// All numbers are little-endian. The index is valid only for the archive
+// with the same size, modification time and end of central directory.
+
+namespace Zip {
+
+	class SidecarIndex {
+	public:
+
+		typedef std::shared_ptr<SidecarIndex> SharedPtr;
+
+		// identifies the archive the index has been made for
+		struct Key {
+			std::uint64_t archiveSize;
+			std::int64_t archiveMTime;
+			std::uint64_t tailHash;
+		};
+
+		// describes an entry by its central directory record
+		struct Entry {
+			std::string name;
+			std::uint16_t method;
+			std::uint16_t flags;
+			std::uint32_t crc;
+			std::uint64_t compSize;
+			std::uint64_t size;
+			std::uint64_t localHeaderOffset;
+		};
+
+		static const std::uint32_t Version = 1;
+
+		// Opens the index file, returns nullptr if it cannot be opened
+		// or is not a valid index.
+		static SharedPtr open(const std::string& indexPath)
+		{
+			MappedFile::SharedPtr mappedFile;
+
+			try {
+				mappedFile = std::make_shared<MappedFile>(indexPath);
+			}
+			catch (const std::runtime_error&) {
+				return nullptr;
+			}
+
+			SharedPtr index(new SidecarIndex(mappedFile));
+
+			return index->isValid() ? index : nullptr;
+		}
+
+		// Writes the index of the entries in the order of the central directory.
+		// The data goes to a temporary file of its own that replaces the index
+		// at once, so more processes can write the index at the same time
+		// and readers never see a partial one.
+		static void write(
+			const std::string& indexPath,
+			const Key& key,
+			const std::vector<Entry>& entries
+		)
+		{
+			if ((std::uint64_t) entries.size() >= 0xFFFFFFFF) {
+				throw std::logic_error("too many entries for an index file");
+			}
+
+			std::uint64_t numOfSlots = 1;
+
+			while (numOfSlots < 2 * (std::uint64_t) entries.size()) {
+				numOfSlots *= 2;
+			}
+
+			std::uint64_t namesSize = 0;
+
+			for (const Entry& entry : entries) {
+				namesSize += entry.name.size();
+			}
+
+			std::uint64_t recordsOffset = HeaderSize + align8(numOfSlots * SlotSize);
+			std::uint64_t namesOffset = recordsOffset + entries.size() * RecordSize;
+
+			std::vector<unsigned char> data((std::size_t) (namesOffset + namesSize));
+
+			unsigned char* header = data.data();
+
+			std::memcpy(header, magic(), 8);
+			put32(header + 8, Version);
+			put64(header + 16, key.archiveSize);
+			put64(header + 24, (std::uint64_t) key.archiveMTime);
+			put64(header + 32, key.tailHash);
+			put64(header + 40, entries.size());
+			put64(header + 48, numOfSlots);
+			put64(header + 56, namesSize);
+
+			std::uint64_t nameOffset = 0;
+
+			for (std::size_t i = 0; i < entries.size(); i++) {
+
+				const Entry& entry = entries[i];
+
+				if (entry.name.size() > 0xFFFF) {
+					throw std::logic_error("name of archive entry is too long");
+				}
+
+				std::uint64_t hash = hashName(entry.name.data(), entry.name.size());
+
+				unsigned char* record = data.data() + recordsOffset + i * RecordSize;
+
+				put64(record, hash);
+				put64(record + 8, nameOffset);
+				put64(record + 16, entry.compSize);
+				put64(record + 24, entry.size);
+				put64(record + 32, entry.localHeaderOffset);
+				put32(record + 40, entry.crc);
+				put16(record + 44, (std::uint16_t) entry.name.size());
+				put16(record + 46, entry.method);
+				put16(record + 48, entry.flags);
+
+				std::memcpy(
+					data.data() + namesOffset + nameOffset,
+					entry.name.data(),
+					entry.name.size()
+				);
+
+				nameOffset += entry.name.size();
+
+				// the first of equal names comes first when probing
+				std::uint64_t slot = hash & (numOfSlots - 1);
+
+				while (read32(data.data() + HeaderSize + slot * SlotSize) != 0) {
+					slot = (slot + 1) & (numOfSlots - 1);
+				}
+
+				put32(data.data() + HeaderSize + slot * SlotSize, (std::uint32_t) (i + 1));
+
+			}
+
+			std::string tempPath;
+
+			std::FILE* file = createTempFile(indexPath, tempPath);
+
+			bool written = std::fwrite(data.data(), 1, data.size(), file) == data.size();
+
+			if (std::fclose(file) != 0 || !written) {
+				std::remove(tempPath.c_str());
+				throw std::runtime_error("cannot write index file -> " + tempPath);
+			}
+
+			#ifdef _WIN32
+				bool replaced = MoveFileExA(
+					tempPath.c_str(),
+					indexPath.c_str(),
+					MOVEFILE_REPLACE_EXISTING
+				) != 0;
+			#else
+				bool replaced = std::rename(tempPath.c_str(), indexPath.c_str()) == 0;
+			#endif
+
+			if (!replaced) {
+				std::remove(tempPath.c_str());
+				throw std::runtime_error("cannot replace index file -> " + indexPath);
+			}
+		}
+
+		// returns the modification time of the file in seconds
+		static std::int64_t getFileMTime(const std::string& filePath)
+		{
+			#ifdef _WIN32
+				struct _stat64 fileStat;
+				int failed = _stat64(filePath.c_str(), &fileStat);
+			#else
+				struct stat fileStat;
+				int failed = ::stat(filePath.c_str(), &fileStat);
+			#endif
+
+			if (failed != 0) {
+
+				throw std::runtime_error(
+					"cannot get modification time of file -> " + filePath
+				);
+
+			}
+
+			return (std::int64_t) fileStat.st_mtime;
+		}
+
+		// FNV-1a of the name, also used to check the end of archives
+		static std::uint64_t hashName(const char* name, std::size_t len)
+		{
+			std::uint64_t hash = 14695981039346656037ull;
+
+			for (std::size_t i = 0; i < len; i++) {
+				hash ^= (unsigned char) name[i];
+				hash *= 1099511628211ull;
+			}
+
+			return hash;
+		}
+
+		Key getKey() const
+		{
+			Key key;
+
+			key.archiveSize = read64(_data + 16);
+			key.archiveMTime = (std::int64_t) read64(_data + 24);
+			key.tailHash = read64(_data + 32);
+
+			return key;
+		}
+
+		bool matches(const Key& key) const
+		{
+			Key indexKey = getKey();
+
+			return indexKey.archiveSize == key.archiveSize
+				&& indexKey.archiveMTime == key.archiveMTime
+				&& indexKey.tailHash == key.tailHash;
+		}
+
+		std::uint64_t getNumOfEntries() const
+		{
+			return _numOfEntries;
+		}
+
+		// looks the entry up in O(1), the first of equal names wins
+		bool find(const std::string& name, Entry& entry) const
+		{
+			std::uint64_t hash = hashName(name.data(), name.size());
+			std::uint64_t slot = hash & (_numOfSlots - 1);
+
+			for (std::uint64_t n = 0; n < _numOfSlots; n++) {
+
+				std::uint32_t number = read32(_slots + slot * SlotSize);
+
+				if (number == 0) {
+					return false;
+				}
+
+				const unsigned char* record = _records + (number - 1) * RecordSize;
+
+				if (read64(record) == hash && read16(record + 44) == name.size()) {
+
+					const unsigned char* recordName = _names + read64(record + 8);
+
+					if (std::memcmp(recordName, name.data(), name.size()) == 0) {
+						entry.name = name;
+						readEntry(record, entry);
+						return true;
+					}
+
+				}
+
+				slot = (slot + 1) & (_numOfSlots - 1);
+			}
+
+			return false;
+		}
+
+	private:
+
+		static const std::size_t HeaderSize = 64;
+		static const std::size_t SlotSize = 4;
+		static const std::size_t RecordSize = 56;
+
+		MappedFile::SharedPtr _mappedFile;
+		const unsigned char* _data;
+		const unsigned char* _slots;
+		const unsigned char* _records;
+		const unsigned char* _names;
+		std::uint64_t _numOfEntries;
+		std::uint64_t _numOfSlots;
+
+		SidecarIndex(MappedFile::SharedPtr mappedFile) :
+			_mappedFile(mappedFile),
+			_data(reinterpret_cast<const unsigned char*>(mappedFile->data())),
+			_slots(nullptr),
+			_records(nullptr),
+			_names(nullptr),
+			_numOfEntries(0),
+			_numOfSlots(0)
+		{}
+
+		// checks the header and the layout against the size of the file
+		bool isValid()
+		{
+			std::uint64_t size = _mappedFile->size();
+
+			if (size < HeaderSize ||
+				std::memcmp(_data, magic(), 8) != 0 ||
+				read32(_data + 8) != Version)
+			{
+				return false;
+			}
+
+			_numOfEntries = read64(_data + 40);
+			_numOfSlots = read64(_data + 48);
+
+			std::uint64_t namesSize = read64(_data + 56);
+
+			// the slots are a power of two with room for all entries
+			if (_numOfSlots == 0 ||
+				(_numOfSlots & (_numOfSlots - 1)) != 0 ||
+				_numOfSlots > size / SlotSize ||
+				_numOfEntries >= _numOfSlots ||
+				_numOfEntries > size / RecordSize)
+			{
+				return false;
+			}
+
+			std::uint64_t recordsOffset = HeaderSize + align8(_numOfSlots * SlotSize);
+			std::uint64_t namesOffset = recordsOffset + _numOfEntries * RecordSize;
+
+			if (namesOffset > size || namesSize != size - namesOffset) {
+				return false;
+			}
+
+			_slots = _data + HeaderSize;
+			_records = _data + recordsOffset;
+			_names = _data + namesOffset;
+
+			for (std::uint64_t i = 0; i < _numOfEntries; i++) {
+
+				const unsigned char* record = _records + i * RecordSize;
+
+				std::uint64_t nameOffset = read64(record + 8);
+
+				if (nameOffset > namesSize || read16(record + 44) > namesSize - nameOffset) {
+					return false;
+				}
+
+			}
+
+			for (std::uint64_t slot = 0; slot < _numOfSlots; slot++) {
+
+				if (read32(_slots + slot * SlotSize) > _numOfEntries) {
+					return false;
+				}
+
+			}
+
+			return true;
+		}
+
+		static void readEntry(const unsigned char* record, Entry& entry)
+		{
+			entry.compSize = read64(record + 16);
+			entry.size = read64(record + 24);
+			entry.localHeaderOffset = read64(record + 32);
+			entry.crc = read32(record + 40);
+			entry.method = read16(record + 46);
+			entry.flags = read16(record + 48);
+		}
+
+		static const char* magic()
+		{
+			return "ZCPPIDX1";
+		}
+
+		// creates a file next to the index that no other writer uses,
+		// the name is made of the process id and a counter
+		static std::FILE* createTempFile(const std::string& indexPath, std::string& tempPath)
+		{
+			static std::atomic<unsigned> counter(0);
+
+			#ifdef _WIN32
+				unsigned long processId = (unsigned long) GetCurrentProcessId();
+			#else
+				unsigned long processId = (unsigned long) ::getpid();
+			#endif
+
+			for (int attempt = 0; attempt < 100; attempt++) {
+
+				tempPath = indexPath + "." + std::to_string(processId)
+					+ "-" + std::to_string(counter++) + ".tmp";
+
+				// fails if the file exists, e.g. left by a crashed process
+				#ifdef _WIN32
+					int fd = -1;
+
+					errno = _sopen_s(
+						&fd,
+						tempPath.c_str(),
+						_O_CREAT | _O_EXCL | _O_WRONLY | _O_BINARY,
+						_SH_DENYNO,
+						_S_IREAD | _S_IWRITE
+					);
+				#else
+					int fd = ::open(tempPath.c_str(), O_CREAT | O_EXCL | O_WRONLY, 0666);
+				#endif
+
+				if (fd < 0) {
+
+					if (errno != EEXIST) {
+						break;
+					}
+
+					continue;
+				}
+
+				#ifdef _WIN32
+					std::FILE* file = _fdopen(fd, "wb");
+				#else
+					std::FILE* file = ::fdopen(fd, "wb");
+				#endif
+
+				if (!file) {
+
+					int error = errno;
+
+					#ifdef _WIN32
+						_close(fd);
+					#else
+						::close(fd);
+					#endif
+
+					std::remove(tempPath.c_str());
+
+					errno = error;
+					break;
+				}
+
+				return file;
+
+			}
+
+			throw std::runtime_error(
+				"cannot create index file -> " + tempPath + ": " + std::strerror(errno)
+			);
+		}
+
+		static std::uint64_t align8(std::uint64_t value)
+		{
+			return (value + 7) & ~(std::uint64_t) 7;
+		}
+
+		static std::uint16_t read16(const unsigned char* p)
+		{
+			return (std::uint16_t) (p[0] | p[1] << 8);
+		}
+
+		static std::uint32_t read32(const unsigned char* p)
+		{
+			return (std::uint32_t) read16(p) | (std::uint32_t) read16(p + 2) << 16;
+		}
+
+		static std::uint64_t read64(const unsigned char* p)
+		{
+			return (std::uint64_t) read32(p) | (std::uint64_t) read32(p + 4) << 32;
+		}
+
+		static void put16(unsigned char* p, std::uint16_t value)
+		{
+			p[0] = (unsigned char) value;
+			p[1] = (unsigned char) (value >> 8);
+		}
+
+		static void put32(unsigned char* p, std::uint32_t value)
+		{
+			put16(p, (std::uint16_t) value);
+			put16(p + 2, (std::uint16_t) (value >> 16));
+		}
+
+		static void put64(unsigned char* p, std::uint64_t value)
+		{
+			put32(p, (std::uint32_t) value);
+			put32(p + 4, (std::uint32_t) (value >> 32));
+		}
+
+	};
+
+}
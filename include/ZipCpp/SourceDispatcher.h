@@ -0,0 +1,375 @@
+#pragma once
+
+#include "Metrics.h"
+
+#include <zipconf.h>
+#include <zip.h>
+
+#include <type_traits>
+#include <typeinfo>
+
+namespace Zip {
+inline namespace ZIPCPP_METRICS_NAMESPACE {
+
+	// compile-time counterpart of zip_source_make_command_bitmap
+	constexpr zip_int64_t MakeSourceCommandBitmap()
+	{
+		return 0;
+	}
+
+	template<typename... Commands>
+	constexpr zip_int64_t MakeSourceCommandBitmap(zip_source_cmd_t cmd, Commands... rest)
+	{
+		return ((zip_int64_t) 1 << cmd) | MakeSourceCommandBitmap(rest...);
+	}
+
+	// This class generates the libzip callback of a source stream class.
+	// The capabilities are taken from the static constants IsSeekable,
+	// IsWritable and HasFileAttributes of the class, the supported commands
+	// are known at compile time and, for an object of the class itself,
+	// every command is a direct call of its method, so it can be inlined.
+	// The command methods stay virtual: an object of a derived class that
+	// is passed to libzip with the dispatch of its base gets the methods
+	// it overrides called virtually, its own dispatch makes them direct.
+
+	template<typename Source>
+	class SourceDispatcher {
+	public:
+
+		typedef std::integral_constant<bool, Source::IsSeekable> IsSeekable;
+		typedef std::integral_constant<bool, Source::IsWritable> IsWritable;
+		typedef std::integral_constant<bool, Source::HasFileAttributes> HasFileAttributes;
+
+		// bitmap of the supported commands
+		static constexpr zip_int64_t Supports =
+			MakeSourceCommandBitmap(
+				ZIP_SOURCE_OPEN,
+				ZIP_SOURCE_READ,
+				ZIP_SOURCE_CLOSE,
+				ZIP_SOURCE_STAT,
+				ZIP_SOURCE_ERROR,
+				ZIP_SOURCE_FREE
+			) |
+			(IsSeekable::value || HasFileAttributes::value
+				? MakeSourceCommandBitmap(ZIP_SOURCE_SUPPORTS)
+				: 0) |
+			(IsSeekable::value
+				? MakeSourceCommandBitmap(ZIP_SOURCE_SEEK, ZIP_SOURCE_TELL)
+				: 0) |
+			(IsWritable::value
+				? MakeSourceCommandBitmap(
+					ZIP_SOURCE_BEGIN_WRITE,
+					ZIP_SOURCE_COMMIT_WRITE,
+					ZIP_SOURCE_ROLLBACK_WRITE,
+					ZIP_SOURCE_WRITE,
+					ZIP_SOURCE_SEEK_WRITE,
+					ZIP_SOURCE_TELL_WRITE,
+					ZIP_SOURCE_REMOVE
+				)
+				: 0) |
+			(HasFileAttributes::value
+				? MakeSourceCommandBitmap(ZIP_SOURCE_GET_FILE_ATTRIBUTES)
+				: 0);
+
+		static zip_int64_t dispatch(
+			void *userdata,
+			void *data,
+			zip_uint64_t len,
+			zip_source_cmd_t cmd
+		)
+		{
+			Source* src = static_cast<Source*>(userdata);
+
+			if (typeid(*src) == typeid(Source)) {
+				return run<DirectCall>(src, data, len, cmd);
+			}
+
+			return run<VirtualCall>(src, data, len, cmd);
+		}
+
+	private:
+
+		// calls the methods of Source itself, so they can be inlined
+		struct DirectCall {
+			static zip_int64_t open(Source* src) { return src->Source::open(); }
+			static zip_int64_t read(Source* src, char* data, zip_uint64_t len) { return src->Source::read(data, len); }
+			static zip_int64_t close(Source* src) { return src->Source::close(); }
+			static zip_int64_t stat(Source* src, zip_stat_t* data) { return src->Source::stat(data); }
+			static zip_int64_t error(Source* src, void* data, zip_uint64_t len) { return src->Source::error(data, len); }
+			static zip_int64_t free(Source* src) { return src->Source::free(); }
+			static zip_int64_t seek(Source* src, void* data, zip_uint64_t len) { return src->Source::seek(data, len); }
+			static zip_int64_t tell(Source* src) { return src->Source::tell(); }
+			static zip_int64_t beginWrite(Source* src) { return src->Source::beginWrite(); }
+			static zip_int64_t commitWrite(Source* src) { return src->Source::commitWrite(); }
+			static zip_int64_t rollbackWrite(Source* src) { return src->Source::rollbackWrite(); }
+			static zip_int64_t write(Source* src, const char* data, zip_uint64_t len) { return src->Source::write(data, len); }
+			static zip_int64_t seekWrite(Source* src, void* data, zip_uint64_t len) { return src->Source::seekWrite(data, len); }
+			static zip_int64_t tellWrite(Source* src) { return src->Source::tellWrite(); }
+			static zip_int64_t remove(Source* src) { return src->Source::remove(); }
+			static zip_int64_t getFileAttributes(Source* src, void* data, zip_uint64_t len) { return src->Source::getFileAttributes(data, len); }
+		};
+
+		// calls the methods overridden by a class derived from Source
+		struct VirtualCall {
+			static zip_int64_t open(Source* src) { return src->open(); }
+			static zip_int64_t read(Source* src, char* data, zip_uint64_t len) { return src->read(data, len); }
+			static zip_int64_t close(Source* src) { return src->close(); }
+			static zip_int64_t stat(Source* src, zip_stat_t* data) { return src->stat(data); }
+			static zip_int64_t error(Source* src, void* data, zip_uint64_t len) { return src->error(data, len); }
+			static zip_int64_t free(Source* src) { return src->free(); }
+			static zip_int64_t seek(Source* src, void* data, zip_uint64_t len) { return src->seek(data, len); }
+			static zip_int64_t tell(Source* src) { return src->tell(); }
+			static zip_int64_t beginWrite(Source* src) { return src->beginWrite(); }
+			static zip_int64_t commitWrite(Source* src) { return src->commitWrite(); }
+			static zip_int64_t rollbackWrite(Source* src) { return src->rollbackWrite(); }
+			static zip_int64_t write(Source* src, const char* data, zip_uint64_t len) { return src->write(data, len); }
+			static zip_int64_t seekWrite(Source* src, void* data, zip_uint64_t len) { return src->seekWrite(data, len); }
+			static zip_int64_t tellWrite(Source* src) { return src->tellWrite(); }
+			static zip_int64_t remove(Source* src) { return src->remove(); }
+			static zip_int64_t getFileAttributes(Source* src, void* data, zip_uint64_t len) { return src->getFileAttributes(data, len); }
+		};
+
+		template<typename Call>
+		static zip_int64_t run(
+			Source* src,
+			void *data,
+			zip_uint64_t len,
+			zip_source_cmd_t cmd
+		)
+		{
+			zip_int64_t result = -1;
+
+			switch (cmd) {
+
+				case ZIP_SOURCE_SUPPORTS: // check whether source supports command
+					result = Supports;
+				break;
+
+				case ZIP_SOURCE_OPEN: // prepare for reading
+					result = Call::open(src);
+				break;
+
+				case ZIP_SOURCE_READ: // read data
+
+					result = Call::read(
+						src,
+						reinterpret_cast<char*>(data),
+						len
+					);
+
+					Metrics::addCount(MetricId::SourceReads);
+					Metrics::addCount(MetricId::SourceReadBytes, result > 0 ? result : 0);
+
+				break;
+
+				case ZIP_SOURCE_CLOSE: // reading is done
+					result = Call::close(src);
+				break;
+
+				case ZIP_SOURCE_STAT: // get meta information
+					result = Call::stat(
+						src,
+						reinterpret_cast<zip_stat_t*>(data)
+					);
+				break;
+
+				case ZIP_SOURCE_ERROR: // get error information
+					result = Call::error(src, data, len);
+				break;
+
+				case ZIP_SOURCE_FREE: // cleanup and free resources
+					result = Call::free(src);
+				break;
+
+				case ZIP_SOURCE_SEEK: // set position for reading
+					result = seek<Call>(src, data, len, IsSeekable());
+				break;
+
+				case ZIP_SOURCE_TELL: // get read position
+					result = tell<Call>(src, IsSeekable());
+				break;
+
+				case ZIP_SOURCE_BEGIN_WRITE: // prepare for writing
+					result = beginWrite<Call>(src, IsWritable());
+				break;
+
+				case ZIP_SOURCE_COMMIT_WRITE: // writing is done
+					result = commitWrite<Call>(src, IsWritable());
+				break;
+
+				case ZIP_SOURCE_ROLLBACK_WRITE: // discard written changes
+					result = rollbackWrite<Call>(src, IsWritable());
+				break;
+
+				case ZIP_SOURCE_WRITE: // write data
+
+					result = write<Call>(src, reinterpret_cast<char*>(data), len, IsWritable());
+
+					Metrics::addCount(MetricId::SourceWrites);
+					Metrics::addCount(MetricId::SourceWriteBytes, result > 0 ? result : 0);
+
+				break;
+
+				case ZIP_SOURCE_SEEK_WRITE: // set position for writing
+					result = seekWrite<Call>(src, data, len, IsWritable());
+				break;
+
+				case ZIP_SOURCE_TELL_WRITE: // get write position
+					result = tellWrite<Call>(src, IsWritable());
+				break;
+
+				case ZIP_SOURCE_REMOVE: // remove file
+					result = remove<Call>(src, IsWritable());
+				break;
+
+				case ZIP_SOURCE_GET_FILE_ATTRIBUTES: // get file attributes
+					result = getFileAttributes<Call>(src, data, len, HasFileAttributes());
+				break;
+
+				default: // invalid command
+					src->_lastError.setCode(ZIP_ER_INVAL);
+
+			}
+
+			return result;
+		}
+
+		// commands the source does not support end up here
+		static zip_int64_t unsupported(Source* src)
+		{
+			src->_lastError.setCode(ZIP_ER_INVAL);
+			return -1;
+		}
+
+		template<typename Call>
+		static zip_int64_t seek(Source* src, void* data, zip_uint64_t len, std::true_type)
+		{
+			return Call::seek(src, data, len);
+		}
+
+		template<typename Call>
+		static zip_int64_t seek(Source* src, void*, zip_uint64_t, std::false_type)
+		{
+			return unsupported(src);
+		}
+
+		template<typename Call>
+		static zip_int64_t tell(Source* src, std::true_type)
+		{
+			return Call::tell(src);
+		}
+
+		template<typename Call>
+		static zip_int64_t tell(Source* src, std::false_type)
+		{
+			return unsupported(src);
+		}
+
+		template<typename Call>
+		static zip_int64_t beginWrite(Source* src, std::true_type)
+		{
+			return Call::beginWrite(src);
+		}
+
+		template<typename Call>
+		static zip_int64_t beginWrite(Source* src, std::false_type)
+		{
+			return unsupported(src);
+		}
+
+		template<typename Call>
+		static zip_int64_t commitWrite(Source* src, std::true_type)
+		{
+			return Call::commitWrite(src);
+		}
+
+		template<typename Call>
+		static zip_int64_t commitWrite(Source* src, std::false_type)
+		{
+			return unsupported(src);
+		}
+
+		template<typename Call>
+		static zip_int64_t rollbackWrite(Source* src, std::true_type)
+		{
+			return Call::rollbackWrite(src);
+		}
+
+		template<typename Call>
+		static zip_int64_t rollbackWrite(Source* src, std::false_type)
+		{
+			return unsupported(src);
+		}
+
+		template<typename Call>
+		static zip_int64_t write(Source* src, const char* data, zip_uint64_t len, std::true_type)
+		{
+			return Call::write(src, data, len);
+		}
+
+		template<typename Call>
+		static zip_int64_t write(Source* src, const char*, zip_uint64_t, std::false_type)
+		{
+			return unsupported(src);
+		}
+
+		template<typename Call>
+		static zip_int64_t seekWrite(Source* src, void* data, zip_uint64_t len, std::true_type)
+		{
+			return Call::seekWrite(src, data, len);
+		}
+
+		template<typename Call>
+		static zip_int64_t seekWrite(Source* src, void*, zip_uint64_t, std::false_type)
+		{
+			return unsupported(src);
+		}
+
+		template<typename Call>
+		static zip_int64_t tellWrite(Source* src, std::true_type)
+		{
+			return Call::tellWrite(src);
+		}
+
+		template<typename Call>
+		static zip_int64_t tellWrite(Source* src, std::false_type)
+		{
+			return unsupported(src);
+		}
+
+		template<typename Call>
+		static zip_int64_t remove(Source* src, std::true_type)
+		{
+			return Call::remove(src);
+		}
+
+		template<typename Call>
+		static zip_int64_t remove(Source* src, std::false_type)
+		{
+			return unsupported(src);
+		}
+
+		template<typename Call>
+		static zip_int64_t getFileAttributes(
+			Source* src,
+			void* data,
+			zip_uint64_t len,
+			std::true_type
+		)
+		{
+			return Call::getFileAttributes(src, data, len);
+		}
+
+		template<typename Call>
+		static zip_int64_t getFileAttributes(Source* src, void*, zip_uint64_t, std::false_type)
+		{
+			return unsupported(src);
+		}
+
+	};
+
+	template<typename Source>
+	constexpr zip_int64_t SourceDispatcher<Source>::Supports;
+
+}
+}
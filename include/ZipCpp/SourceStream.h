@@ -1,5 +1,8 @@
 #pragma once
 
+#include <zipconf.h>
+#include <zip.h>
+
 #include <memory>
 
 namespace Zip {
@@ -9,6 +12,19 @@ namespace Zip {
 
 		typedef std::shared_ptr<SourceStream> SharedPtr;
 
+		virtual ~SourceStream()
+		{}
+
+		// reads up to len bytes from the beginning of the data without consuming them,
+		// returns -1 if the source does not support it
+		virtual zip_int64_t peek(char* buff, zip_uint64_t len)
+		{
+			(void) buff;
+			(void) len;
+
+			return -1;
+		}
+
 	};
 
 }
@@ -0,0 +1,223 @@
+#pragma once
+
+#include <cstdio>
+#include <cstring>
+#include <ios>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+
+// This class implements a write-once/read-back stream that keeps
+// at most a given number of bytes in memory and moves the rest
+// of its contents into an anonymous temporary file
+
+namespace Zip {
+
+	class SpoolStream {
+	public:
+
+		typedef std::shared_ptr<SpoolStream> SharedPtr;
+		typedef std::weak_ptr<SpoolStream> WeakPtr;
+
+		static const std::size_t Unlimited = (std::numeric_limits<std::size_t>::max)();
+
+		SpoolStream(std::size_t memoryLimit = Unlimited) :
+			_memoryLimit(memoryLimit),
+			_file(nullptr),
+			_size(0),
+			_readPos(0),
+			_fileWritePos(true),
+			_eof(false),
+			_fail(false),
+			_nread(0)
+		{}
+
+		SpoolStream(const SpoolStream&) = delete;
+		SpoolStream& operator= (const SpoolStream&) = delete;
+
+		~SpoolStream()
+		{
+			if (_file) {
+				std::fclose(_file);
+			}
+		}
+
+		bool eof() const { return _eof; }
+		bool fail() const { return _fail; }
+		bool good() const { return !_eof && !_fail; }
+		std::streamsize gcount() const { return _nread; }
+
+		// returns the number of bytes written so far
+		unsigned long long size() const
+		{
+			return _size;
+		}
+
+		// returns true if the contents have been moved to a temporary file
+		bool isSpilled() const
+		{
+			return _file != nullptr;
+		}
+
+		void clear()
+		{
+			_eof = false;
+			_fail = false;
+		}
+
+		// restarts reading from the beginning of the contents
+		void rewind()
+		{
+			_readPos = 0;
+			// force repositioning of the file before the next read
+			_fileWritePos = true;
+			clear();
+		}
+
+		void flush()
+		{
+			if (_file && std::fflush(_file) != 0) {
+				_fail = true;
+			}
+		}
+
+		void write(const char* buf, std::streamsize nbytes)
+		{
+			if (_fail || nbytes <= 0) {
+				return;
+			}
+
+			std::size_t len = (std::size_t) nbytes;
+
+			if (!_file && len > _memoryLimit - _buffer.size()) {
+				// the memory window is exhausted,
+				// move the buffered data to a temporary file
+				if (!spill()) {
+					_fail = true;
+					return;
+				}
+			}
+
+			if (_file) {
+
+				if (!seekFile(_size, true)) {
+					_fail = true;
+					return;
+				}
+
+				if (std::fwrite(buf, 1, len, _file) != len) {
+					_fail = true;
+					return;
+				}
+
+			}
+			else {
+				_buffer.insert(_buffer.end(), buf, buf + len);
+			}
+
+			_size += len;
+		}
+
+		void read(char* buf, std::streamsize nbytes)
+		{
+			_nread = 0;
+
+			if (_eof || _fail || nbytes <= 0) {
+				return;
+			}
+
+			std::size_t len = (std::size_t) nbytes;
+			unsigned long long avail = _size - _readPos;
+
+			if (len > avail) {
+				len = (std::size_t) avail;
+			}
+
+			if (_file) {
+
+				if (!seekFile(_readPos, false)) {
+					_fail = true;
+					return;
+				}
+
+				len = std::fread(buf, 1, len, _file);
+
+				if (std::ferror(_file)) {
+					_fail = true;
+					return;
+				}
+
+			}
+			else if (len > 0) {
+				std::memcpy(buf, _buffer.data() + _readPos, len);
+			}
+
+			_readPos += len;
+			_nread = (std::streamsize) len;
+
+			if (_nread < nbytes) {
+				// like std::istream, a short read sets both flags
+				_eof = true;
+				_fail = true;
+			}
+		}
+
+	private:
+
+		std::size_t _memoryLimit;
+		std::vector<char> _buffer;
+		std::FILE* _file;
+
+		unsigned long long _size;
+		unsigned long long _readPos;
+		// tracks whether the file position is at the end of the written data
+		bool _fileWritePos;
+
+		bool _eof;
+		bool _fail;
+		std::streamsize _nread;
+
+		bool spill()
+		{
+			_file = std::tmpfile();
+
+			if (!_file) {
+				return false;
+			}
+
+			if (!_buffer.empty()) {
+
+				if (std::fwrite(_buffer.data(), 1, _buffer.size(), _file) != _buffer.size()) {
+					return false;
+				}
+
+			}
+
+			// release the memory window
+			std::vector<char>().swap(_buffer);
+			_fileWritePos = true;
+
+			return true;
+		}
+
+		bool seekFile(unsigned long long pos, bool forWriting)
+		{
+			// writes only append and reads are sequential, so the file
+			// has to be repositioned only when switching between them
+			if (forWriting == _fileWritePos) {
+				return true;
+			}
+
+			_fileWritePos = forWriting;
+
+			#ifdef _WIN32
+				return _fseeki64(_file, (long long) pos, SEEK_SET) == 0;
+			#else
+				return fseeko(_file, (off_t) pos, SEEK_SET) == 0;
+			#endif
+		}
+
+	};
+
+}
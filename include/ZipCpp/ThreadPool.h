@@ -0,0 +1,182 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// This class implements a fixed-size pool of worker threads
+
+namespace Zip {
+
+	class ThreadPool {
+	public:
+
+		typedef std::shared_ptr<ThreadPool> SharedPtr;
+		typedef std::function<void()> Task;
+
+		// creates a pool with the given number of threads,
+		// zero means one thread per hardware core
+		explicit ThreadPool(unsigned numOfThreads = 0) :
+			_stopping(false)
+		{
+			if (numOfThreads == 0) {
+				numOfThreads = std::thread::hardware_concurrency();
+			}
+
+			if (numOfThreads == 0) {
+				numOfThreads = 1;
+			}
+
+			for (unsigned i = 0; i < numOfThreads; i++) {
+				_threads.emplace_back([this]() { workerLoop(); });
+			}
+		}
+
+		ThreadPool(const ThreadPool&) = delete;
+		ThreadPool& operator= (const ThreadPool&) = delete;
+
+		// finishes all queued tasks and joins the threads
+		~ThreadPool()
+		{
+			{
+				std::lock_guard<std::mutex> lock(_mutex);
+				_stopping = true;
+			}
+
+			_taskAvailable.notify_all();
+
+			for (auto& thread : _threads) {
+				thread.join();
+			}
+		}
+
+		unsigned size() const
+		{
+			return (unsigned) _threads.size();
+		}
+
+		// queues a task for execution on one of the threads
+		void post(Task task)
+		{
+			{
+				std::lock_guard<std::mutex> lock(_mutex);
+				_tasks.push_back(std::move(task));
+			}
+
+			_taskAvailable.notify_one();
+		}
+
+		// calls func(index) for every index in [0, count) and waits for completion;
+		// idle threads pick up the next unprocessed index, so uneven items
+		// are balanced across the pool, and the first exception is rethrown;
+		// must not be called from a task running on the same pool
+		template<typename Func>
+		void forEach(std::size_t count, Func func)
+		{
+			if (count == 0) {
+				return;
+			}
+
+			struct State {
+				std::atomic<std::size_t> next;
+				std::size_t running;
+				std::exception_ptr error;
+				std::mutex mutex;
+				std::condition_variable done;
+			};
+
+			auto state = std::make_shared<State>();
+
+			state->next = 0;
+			state->running = count < size() ? count : size();
+
+			for (std::size_t i = 0, n = state->running; i < n; i++) {
+
+				post([state, count, &func]()
+				{
+					for (;;) {
+
+						std::size_t index = state->next++;
+
+						if (index >= count) {
+							break;
+						}
+
+						try {
+							func(index);
+						}
+						catch (...) {
+
+							std::lock_guard<std::mutex> lock(state->mutex);
+
+							if (!state->error) {
+								state->error = std::current_exception();
+							}
+
+							// skip the remaining items
+							state->next = count;
+						}
+
+					}
+
+					std::lock_guard<std::mutex> lock(state->mutex);
+
+					if (--state->running == 0) {
+						state->done.notify_all();
+					}
+				});
+
+			}
+
+			std::unique_lock<std::mutex> lock(state->mutex);
+
+			state->done.wait(lock, [&state]() { return state->running == 0; });
+
+			if (state->error) {
+				std::rethrow_exception(state->error);
+			}
+		}
+
+	private:
+
+		std::vector<std::thread> _threads;
+		std::deque<Task> _tasks;
+		std::mutex _mutex;
+		std::condition_variable _taskAvailable;
+		bool _stopping;
+
+		void workerLoop()
+		{
+			for (;;) {
+
+				Task task;
+
+				{
+					std::unique_lock<std::mutex> lock(_mutex);
+
+					_taskAvailable.wait(lock, [this]() {
+						return _stopping || !_tasks.empty();
+					});
+
+					if (_tasks.empty()) {
+						// stopping and nothing left to do
+						return;
+					}
+
+					task = std::move(_tasks.front());
+					_tasks.pop_front();
+				}
+
+				task();
+			}
+		}
+
+	};
+
+}
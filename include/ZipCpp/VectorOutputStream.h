@@ -0,0 +1,93 @@
+#pragma once
+
+#include <cstring>
+#include <memory>
+#include <new>
+#include <vector>
+
+// This class writes directly into a growable vector without an iostream layer,
+// the previous content of the vector is replaced
+
+namespace Zip {
+
+	class VectorOutputStream {
+	public:
+
+		typedef std::shared_ptr<VectorOutputStream> SharedPtr;
+
+		static const int beg = 0;
+		static const int cur = 1;
+		static const int end = 2;
+
+		VectorOutputStream(std::vector<char>* buffer) :
+			_buffer(buffer),
+			_pos(0),
+			_failFlag(false)
+		{
+			_buffer->clear();
+		}
+
+		bool fail() const { return _failFlag; }
+
+		void clear()
+		{
+			_failFlag = false;
+		}
+
+		long long tellp()
+		{
+			return _failFlag ? -1 : (long long) _pos;
+		}
+
+		void seekp(long long pos, int dir)
+		{
+			if (dir == cur) {
+				pos += (long long) _pos;
+			}
+			else if (dir == end) {
+				pos += (long long) _buffer->size();
+			}
+
+			if (pos < 0 || (std::size_t) pos > _buffer->size()) {
+				_failFlag = true;
+				return;
+			}
+
+			_pos = (std::size_t) pos;
+		}
+
+		void write(const char* data, long long len)
+		{
+			if (len <= 0) {
+				return;
+			}
+
+			std::size_t size = (std::size_t) len;
+
+			try {
+
+				if (_pos + size > _buffer->size()) {
+					// the vector grows geometrically, so appending is amortized O(1)
+					_buffer->resize(_pos + size);
+				}
+
+			}
+			catch (const std::bad_alloc&) {
+				// libzip calls the stream from C code, so nothing may be thrown
+				_failFlag = true;
+				return;
+			}
+
+			std::memcpy(_buffer->data() + _pos, data, size);
+			_pos += size;
+		}
+
+	private:
+
+		std::vector<char>* _buffer;
+		std::size_t _pos;
+		bool _failFlag;
+
+	};
+
+}
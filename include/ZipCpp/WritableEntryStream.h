@@ -1,12 +1,13 @@
 #pragma once
 
 #include "ZipHandle.h"
+#include "SpoolStream.h"
 
 #include <functional>
-#include <sstream>
 #include <string>
 
 namespace Zip {
+inline namespace ZIPCPP_METRICS_NAMESPACE {
 
 	class WritableEntryStream {
 	public:
@@ -16,7 +17,7 @@ namespace Zip {
 
 		WritableEntryStream(
 			ZipHandle::WeakPtr handle,
-			std::weak_ptr<std::stringstream> ostream
+			SpoolStream::WeakPtr ostream
 		) :
 			_handle(handle),
 			_ostream(ostream)
@@ -55,6 +56,7 @@ namespace Zip {
 		{
 			if (auto os = _ostream.lock()) {
 				os->write(buf, nbytes);
+				Metrics::addCount(MetricId::EntryWriteBytes, (std::uint64_t) nbytes);
 			}
 		}
 
@@ -68,8 +70,9 @@ namespace Zip {
 	private:
 
 		ZipHandle::WeakPtr _handle;
-		std::weak_ptr<std::stringstream> _ostream;
+		SpoolStream::WeakPtr _ostream;
 
 	};
 
+}
 }
\ No newline at end of file
@@ -2,6 +2,9 @@
 
 #include "SeekableSourceStream.h"
 
+#include <cstring>
+#include <vector>
+
 #define ZIP_WRITABLE_SOURCE_STREAM_SUPPORTS \
 	ZIP_SOURCE_BEGIN_WRITE, \
 	ZIP_SOURCE_COMMIT_WRITE, \
@@ -12,11 +15,14 @@
 	ZIP_SOURCE_REMOVE
 
 namespace Zip {
+inline namespace ZIPCPP_METRICS_NAMESPACE {
 
 	template<typename InputStream, typename OutputStream>
 	class WritableSourceStream : public SeekableSourceStream<InputStream> {
 	public:
 
+		static const bool IsWritable = true;
+
 		static zip_int64_t dispatch(
 			void *userdata,
 			void *data,
@@ -24,93 +30,73 @@ namespace Zip {
 			zip_source_cmd_t cmd
 		)
 		{
-			zip_int64_t result = -1;
-
-			WritableSourceStream* src = reinterpret_cast<
-				WritableSourceStream*
-			>(userdata);
-
-			switch (cmd) {
-
-				case ZIP_SOURCE_BEGIN_WRITE: // prepare for writing
-					result = src->beginWrite();
-				break;
-
-				case ZIP_SOURCE_COMMIT_WRITE: // writing is done
-					result = src->commitWrite();
-				break;
-
-				case ZIP_SOURCE_ROLLBACK_WRITE: // discard written changes
-					result = src->rollbackWrite();
-				break;
-
-				case ZIP_SOURCE_WRITE: // write data
-					result = src->write(
-						reinterpret_cast<char*>(data),
-						len
-					);
-				break;
-
-				case ZIP_SOURCE_SEEK_WRITE: // set position for writing
-					result = src->seekWrite(data, len);
-				break;
-
-				case ZIP_SOURCE_TELL_WRITE: // get write position
-					result = src->tellWrite();
-				break;
-
-				case ZIP_SOURCE_REMOVE: // remove file
-					result = src->remove();
-				break;
-
-				default:
-
-					result = SeekableSourceStream<InputStream>::dispatch(
-						userdata,
-						data,
-						len,
-						cmd
-					);
-
-			}
-
-			return result;
+			return SourceDispatcher<WritableSourceStream>::dispatch(userdata, data, len, cmd);
 		}
 
-		WritableSourceStream(InputStream inputStreamPtr, OutputStream outputStreamPtr) :
+		static const std::size_t DefaultWriteBufferSize = 1024 * 1024;
+
+		// Small writes are collected in a buffer of the given size, so the output
+		// stream is only used when the buffer is full, when seeking and when
+		// writing is done; zero writes all data through immediately.
+		WritableSourceStream(
+			InputStream inputStreamPtr,
+			OutputStream outputStreamPtr,
+			std::size_t writeBufferSize = DefaultWriteBufferSize
+		) :
 			SeekableSourceStream<InputStream>(inputStreamPtr),
 			_outputStreamPtr(outputStreamPtr),
-			_outputSize(0)
+			_outputSize(0),
+			_writePos(0),
+			_writeBufferSize(writeBufferSize),
+			_numOfBufferedBytes(0)
 		{}
 
 	protected:
 
+		template<typename> friend class SourceDispatcher;
+
 		OutputStream _outputStreamPtr;
 		zip_int64_t _outputSize;
-
-		virtual zip_int64_t supports()
-		{
-			return zip_source_make_command_bitmap(
-				ZIP_READABLE_SOURCE_STREAM_SUPPORTS,
-				ZIP_SEEKABLE_SOURCE_STREAM_SUPPORTS,
-				ZIP_WRITABLE_SOURCE_STREAM_SUPPORTS,
-				-1
-			);
-		}
+		// write position tracked without asking the output stream
+		zip_int64_t _writePos;
+		std::size_t _writeBufferSize;
+		std::vector<char> _writeBuffer;
+		std::size_t _numOfBufferedBytes;
 
 		virtual zip_int64_t beginWrite()
 		{
-			_outputSize = 0;
+			_writePos = _outputStreamPtr->tellp();
+
+			if (_writePos < 0) {
+				// the output stream does not report positions
+				_writePos = 0;
+			}
+
+			_outputSize = _writePos;
+
+			_writeBuffer.resize(_writeBufferSize);
+			_numOfBufferedBytes = 0;
+
 			return 0;
 		}
 
 		virtual zip_int64_t commitWrite()
 		{
+			bool flushed = flushWriteBuffer();
+
+			releaseWriteBuffer();
+
+			if (!flushed) {
+				lastError().setCode(ZIP_ER_WRITE);
+				return -1;
+			}
+
 			return 0;
 		}
 
 		virtual zip_int64_t rollbackWrite()
 		{
+			releaseWriteBuffer();
 			return 0;
 		}
 
@@ -121,36 +107,63 @@ namespace Zip {
 				return -1;
 			}
 
-			zip_int64_t oldWritePos = _outputStreamPtr->tellp();
+			if (len == 0) {
+				return 0;
+			}
 
-			_outputStreamPtr->write(data, len);
+			if (_numOfBufferedBytes + len <= _writeBuffer.size()) {
+
+				std::memcpy(_writeBuffer.data() + _numOfBufferedBytes, data, len);
+				_numOfBufferedBytes += len;
+
+			}
+			else {
+
+				if (!flushWriteBuffer()) {
+					lastError().setCode(ZIP_ER_WRITE);
+					return -1;
+				}
+
+				if (len < _writeBuffer.size()) {
+
+					std::memcpy(_writeBuffer.data(), data, len);
+					_numOfBufferedBytes = len;
+
+				}
+				else {
+
+					// too large to be worth buffering
+					_outputStreamPtr->write(data, len);
+
+					if (_outputStreamPtr->fail()) {
+						lastError().setCode(ZIP_ER_WRITE);
+						return -1;
+					}
+
+				}
 
-			if (_outputStreamPtr->fail()) {
-				lastError().setCode(ZIP_ER_WRITE);
-				return -1;
 			}
 
-			zip_int64_t newWritePos = _outputStreamPtr->tellp();
-			zip_int64_t written = newWritePos - oldWritePos;
+			_writePos += len;
 
-			_outputSize += written;
+			if (_writePos > _outputSize) {
+				_outputSize = _writePos;
+			}
 
-			return written;
+			return len;
 		}
 
 		virtual zip_int64_t seekWrite(void *data, zip_uint64_t len)
 		{
-			// is the output stream ready?
-			if (_outputStreamPtr->fail()) {
+			// write buffered data at the current position first
+			if (!flushWriteBuffer()) {
 				lastError().setCode(ZIP_ER_SEEK);
 				return -1;
 			}
 
-			zip_int64_t oldOffset = _outputStreamPtr->tellp();
-
 			// validate arguments and compute a new offset
 			zip_int64_t newOffset = zip_source_seek_compute_offset(
-				oldOffset,
+				_writePos,
 				_outputSize,
 				data,
 				len,
@@ -168,6 +181,8 @@ namespace Zip {
 				return -1;
 			}
 
+			_writePos = newOffset;
+
 			return 0;
 		}
 
@@ -179,7 +194,7 @@ namespace Zip {
 				return -1;
 			}
 
-			return _outputStreamPtr->tellp();
+			return _writePos;
 		}
 
 		virtual zip_int64_t remove()
@@ -194,6 +209,26 @@ namespace Zip {
 			return ReadableSourceStream<InputStream>::_lastError;
 		}
 
+		// writes the buffered data to the output stream
+		bool flushWriteBuffer()
+		{
+			if (_numOfBufferedBytes == 0) {
+				return !_outputStreamPtr->fail();
+			}
+
+			_outputStreamPtr->write(_writeBuffer.data(), _numOfBufferedBytes);
+			_numOfBufferedBytes = 0;
+
+			return !_outputStreamPtr->fail();
+		}
+
+		void releaseWriteBuffer()
+		{
+			std::vector<char>().swap(_writeBuffer);
+			_numOfBufferedBytes = 0;
+		}
+
 	};
 
+}
 }
\ No newline at end of file
@@ -1,6 +1,11 @@
 #pragma once
 
 #include "ArchiveFile.h"
+#include "AsyncArchive.h"
+#include "ConcurrentArchive.h"
 #include "InputArchiveStream.h"
+#include "MappedInputArchive.h"
+#include "MemoryArchive.h"
 #include "OutputArchiveStream.h"
+#include "PrefetchInputStream.h"
 #include "ArchiveStream.h"
@@ -25,6 +25,9 @@ namespace Zip {
 			}
 		}
 
+		ZipFileHandle(const ZipFileHandle&) = delete;
+		ZipFileHandle& operator= (const ZipFileHandle&) = delete;
+
 		RawPtr get()
 		{
 			return _zipFilePtr;
@@ -39,6 +42,17 @@ namespace Zip {
 			);
 		}
 
+		// works for data that is neither compressed nor encrypted
+		// and for the raw data of an entry
+		zip_int8_t seek(zip_int64_t offset, int whence)
+		{
+			return zip_fseek(
+				_zipFilePtr,
+				offset,
+				whence
+			);
+		}
+
 	private:
 
 		RawPtr _zipFilePtr;
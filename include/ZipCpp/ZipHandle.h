@@ -2,11 +2,21 @@
 
 #include "SourceStream.h"
 #include "ZipFileHandle.h"
+#include "EntryReader.h"
 #include "ReadableSourceStream.h"
+#include "EntryNameIndex.h"
+#include "CompressionPolicy.h"
+#include "MemoryResource.h"
+#include "Metrics.h"
 
 #include <map>
+#include <stdexcept>
+#include <string>
+#include <unordered_set>
+#include <vector>
 
 namespace Zip {
+inline namespace ZIPCPP_METRICS_NAMESPACE {
 
 	class ZipHandle {
 	public:
@@ -15,10 +25,21 @@ namespace Zip {
 		typedef std::shared_ptr<ZipHandle> SharedPtr;
 		typedef std::weak_ptr<ZipHandle> WeakPtr;
 
+		// describes an entry whose data will be read from a source when saving
+		struct PendingEntry {
+			zip_uint64_t index;
+			zip_source_callback callback;
+			SourceStream::SharedPtr source;
+			CompressionPolicy compression;
+		};
+
+		typedef std::vector<PendingEntry> PendingEntryList;
+
 		ZipHandle(
 			RawPtr zipPtr = nullptr,
 			SourceStream::SharedPtr sourcePtr = nullptr
 		) :
+			_resource(MemoryResource::getDefault()),
 			_zipPtr(zipPtr),
 			_sourcePtr(sourcePtr),
 			_hasBeenSaved(false)
@@ -71,6 +92,8 @@ namespace Zip {
 			zip_discard(_zipPtr);
 
 			_zipPtr = nullptr;
+			_copySources.clear();
+			_nameIndex.invalidate();
 		}
 
 		// saves changes and closes the archive
@@ -88,8 +111,16 @@ namespace Zip {
 			// close all open files before closing the archive
 			_openFiles.clear();
 
+			// choose methods for entries with automatic compression
+			resolveCompression();
+
 			// save changes and close the archive
-			int result = zip_close(_zipPtr);
+			int result;
+
+			{
+				MetricsTimer timer(MetricId::SaveAndCloseTime);
+				result = zip_close(_zipPtr);
+			}
 
 			if (result == -1) {
 
@@ -101,18 +132,71 @@ namespace Zip {
 			}
 
 			_zipPtr = nullptr;
+			_copySources.clear();
+			_nameIndex.invalidate();
 			_hasBeenSaved = true;
 		}
 
+		// sets the compression policy for entries added afterwards
+		void setDefaultCompression(const CompressionPolicy& compression)
+		{
+			_defaultCompression = compression;
+		}
+
+		const CompressionPolicy& getDefaultCompression() const
+		{
+			return _defaultCompression;
+		}
+
+		// Sets names of entries that exist outside of the libzip archive,
+		// such as those of a file being appended to, they cannot be added.
+		void setReservedNames(std::unordered_set<std::string> names)
+		{
+			_reservedNames = std::move(names);
+		}
+
+		// Sets the resource of objects allocated for the archive from now on,
+		// it cannot be changed while entries are open. The handle keeps
+		// the resource alive, the allocators only refer to it except those
+		// of objects handed to callers, see getOwningAllocator.
+		void setMemoryResource(MemoryResource::SharedPtr resource)
+		{
+			if (!_openFiles.empty()) {
+				throw std::logic_error("cannot change memory resource while entries are open");
+			}
+
+			_resource = resource ? resource : MemoryResource::getDefault();
+			_openFiles = OpenFileMap(getAllocator());
+		}
+
+		const MemoryResource::SharedPtr& getMemoryResource() const
+		{
+			return _resource;
+		}
+
+		ResourceAllocator<char> getAllocator() const
+		{
+			return ResourceAllocator<char>(_resource.get());
+		}
+
+		// allocator of objects that may outlive the handle, such as entry
+		// streams and file handles they refer to, it keeps the resource alive
+		ResourceAllocator<char> getOwningAllocator() const
+		{
+			return ResourceAllocator<char>(_resource.get(), _resource);
+		}
+
 		template<typename InputStream>
 		zip_int64_t attachSourceForSaving(
 			const std::string entryPath,
 			std::shared_ptr<
 				ReadableSourceStream<InputStream>
 			> srcPtr,
-			int flags
+			int flags,
+			const CompressionPolicy& compression
 		)
 		{
+			checkReservedName(entryPath);
 
 			zip_source_t* zipSrcPtr = zip_source_function(
 				get(),
@@ -146,8 +230,144 @@ namespace Zip {
 
 			_attachedSourcesForSaving.push_back(srcPtr);
 
+			_nameIndex.add(entryPath, entryIndex);
+
+			_pendingEntries[entryIndex] = PendingEntry {
+				(zip_uint64_t) entryIndex,
+				&ReadableSourceStream<InputStream>::dispatch,
+				srcPtr,
+				compression
+			};
+
+			if (!compression.isAuto()) {
+				setEntryCompression(entryIndex, compression);
+			}
+
 			return entryIndex;
 		}
+
+		// sets the compression method and level of an entry
+		void setEntryCompression(
+			zip_uint64_t entryIndex,
+			const CompressionPolicy& compression
+		)
+		{
+			if (compression.isDefault()) {
+				return;
+			}
+
+			int failed = zip_set_file_compression(
+				get(),
+				entryIndex,
+				compression.getMethod(),
+				compression.getLevel()
+			);
+
+			if (failed) {
+
+				throw std::runtime_error(
+					std::string("cannot set compression for archive entry -> ")
+						+ zip_strerror(get())
+				);
+
+			}
+		}
+
+		// chooses the compression of pending entries with an automatic policy
+		// from a sample of their data
+		void resolveCompression()
+		{
+			std::vector<char> sample;
+
+			for (auto& item : _pendingEntries) {
+
+				PendingEntry& entry = item.second;
+
+				if (!entry.compression.isAuto()) {
+					continue;
+				}
+
+				sample.resize(entry.compression.getSampleSize());
+
+				zip_int64_t nsample = entry.source->peek(
+					sample.data(),
+					sample.size()
+				);
+
+				if (nsample < 0) {
+					// cannot get a sample, compress it as usual
+					nsample = 0;
+				}
+
+				entry.compression = entry.compression.choose(
+					sample.data(),
+					(std::size_t) nsample
+				);
+
+				setEntryCompression(entry.index, entry.compression);
+
+			}
+		}
+
+		// returns entries that will be read from attached sources when saving
+		PendingEntryList getPendingEntries()
+		{
+			PendingEntryList pendingEntries;
+
+			pendingEntries.reserve(_pendingEntries.size());
+
+			for (auto& item : _pendingEntries) {
+				pendingEntries.push_back(item.second);
+			}
+
+			return pendingEntries;
+		}
+
+		// replaces the data source of an entry while keeping its name and settings
+		void replaceEntrySource(
+			zip_uint64_t entryIndex,
+			zip_source_callback callback,
+			SourceStream::SharedPtr srcPtr
+		)
+		{
+			zip_source_t* zipSrcPtr = zip_source_function(
+				get(),
+				callback,
+				srcPtr.get()
+			);
+
+			if (!zipSrcPtr) {
+				throw std::runtime_error(
+					"cannot create zip archive data source"
+				);
+			}
+
+			int failed = zip_file_replace(
+				get(),
+				entryIndex,
+				zipSrcPtr,
+				0
+			);
+
+			if (failed) {
+
+				zip_source_free(zipSrcPtr);
+
+				throw std::runtime_error(
+					std::string("cannot replace archive entry data -> ")
+						+ zip_strerror(get())
+				);
+
+			}
+
+			_attachedSourcesForSaving.push_back(srcPtr);
+
+			PendingEntry& pendingEntry = _pendingEntries[entryIndex];
+
+			pendingEntry.index = entryIndex;
+			pendingEntry.callback = callback;
+			pendingEntry.source = srcPtr;
+		}
 		
 		template<typename InputStream>
 		zip_int64_t addEntry(
@@ -155,12 +375,46 @@ namespace Zip {
 			InputStream readableStream,
 			int flags = 0
 		)
+		{
+			return addEntry(
+				entryPath,
+				readableStream,
+				_defaultCompression,
+				flags
+			);
+		}
+
+		template<typename InputStream>
+		zip_int64_t addEntry(
+			const std::string& entryPath,
+			InputStream readableStream,
+			const CompressionPolicy& compression,
+			int flags = 0
+		)
 		{
 			return attachSourceForSaving(
 				entryPath,
-				std::make_shared<
+				std::allocate_shared<
 					Zip::ReadableSourceStream<InputStream>
-				>(readableStream),
+				>(getAllocator(), readableStream),
+				flags,
+				compression
+			);
+		}
+
+		template<typename InputStream>
+		zip_int64_t addEncryptedEntry(
+			const std::string& entryPath,
+			const std::string& entryPwd,
+			InputStream readableStream,
+			int flags = 0
+		)
+		{
+			return addEncryptedEntry(
+				entryPath,
+				entryPwd,
+				readableStream,
+				_defaultCompression,
 				flags
 			);
 		}
@@ -170,15 +424,17 @@ namespace Zip {
 			const std::string& entryPath,
 			const std::string& entryPwd,
 			InputStream readableStream,
+			const CompressionPolicy& compression,
 			int flags = 0
 		)
 		{
 			zip_int64_t entryIndex = attachSourceForSaving(
 				entryPath,
-				std::make_shared<
+				std::allocate_shared<
 					Zip::ReadableSourceStream<InputStream>
-				>(readableStream),
-				flags
+				>(getAllocator(), readableStream),
+				flags,
+				compression
 			);
 
 			int failed = zip_file_set_encryption(
@@ -200,8 +456,96 @@ namespace Zip {
 			return entryIndex;
 		}
 
+		// adds an entry of another archive, its compressed data is copied as it is,
+		// the other archive is kept open until this one is closed
+		zip_int64_t copyEntryFrom(
+			SharedPtr sourceHandle,
+			zip_uint64_t sourceIndex,
+			const std::string& entryPath
+		)
+		{
+			checkReservedName(entryPath);
+
+			zip_source_t* zipSrcPtr = zip_source_zip(
+				get(),
+				sourceHandle->get(),
+				sourceIndex,
+				ZIP_FL_COMPRESSED,
+				0,
+				-1
+			);
+
+			if (!zipSrcPtr) {
+
+				throw std::runtime_error(
+					std::string("cannot create zip archive data source -> ")
+						+ zip_strerror(get())
+				);
+
+			}
+
+			zip_int64_t entryIndex = zip_file_add(
+				get(),
+				entryPath.c_str(),
+				zipSrcPtr,
+				ZIP_FL_OVERWRITE
+			);
+
+			if (entryIndex < 0) {
+
+				zip_source_free(zipSrcPtr);
+
+				throw std::runtime_error(
+					std::string("cannot add entry to zip archive -> ")
+						+ zip_strerror(get())
+				);
+
+			}
+
+			zip_uint8_t opsys;
+			zip_uint32_t attributes;
+
+			// keep permissions and other attributes of the entry
+			int failed = zip_file_get_external_attributes(
+				sourceHandle->get(),
+				sourceIndex,
+				0,
+				&opsys,
+				&attributes
+			);
+
+			if (!failed) {
+				zip_file_set_external_attributes(get(), entryIndex, 0, opsys, attributes);
+			}
+
+			if (sourceHandle.get() != this) {
+				_copySources.push_back(sourceHandle);
+			}
+
+			_nameIndex.add(entryPath, entryIndex);
+
+			return entryIndex;
+		}
+
+		// returns the index of the entry with the given name or -1 if it does not exist
+		zip_int64_t locateEntry(const std::string& entryPath, int flags)
+		{
+			if (!EntryNameIndex::canLookup(flags)) {
+				return zip_name_locate(get(), entryPath.c_str(), flags);
+			}
+
+			if (!_nameIndex.isBuilt(flags)) {
+				// the index is created lazily on the first lookup
+				_nameIndex.build(get(), flags);
+			}
+
+			return _nameIndex.find(entryPath, flags);
+		}
+
 		ZipFileHandle::SharedPtr openEntry(zip_int64_t entryIndex)
 		{
+			MetricsTimer timer(MetricId::OpenEntryTime);
+
 			zip_file_t* zipFilePtr = zip_fopen_index(
 				get(),
 				entryIndex,
@@ -217,11 +561,13 @@ namespace Zip {
 
 			}
 
-			auto openFile = std::make_shared<
+			auto openFile = std::allocate_shared<
 				ZipFileHandle
-			>(zipFilePtr);
+			>(getOwningAllocator(), zipFilePtr);
 
-			_openFiles[zipFilePtr] = openFile;
+			_openFiles[openFile.get()] = openFile;
+
+			reportOpenedEntry(entryIndex);
 
 			return openFile;
 		}
@@ -231,6 +577,8 @@ namespace Zip {
 			const std::string& entryPwd
 		)
 		{
+			MetricsTimer timer(MetricId::OpenEntryTime);
+
 			zip_file_t* zipFilePtr = zip_fopen_index_encrypted(
 				get(),
 				entryIndex,
@@ -247,22 +595,86 @@ namespace Zip {
 
 			}
 
-			auto openFile = std::make_shared<
+			auto openFile = std::allocate_shared<
 				ZipFileHandle
-			>(zipFilePtr);
+			>(getOwningAllocator(), zipFilePtr);
+
+			_openFiles[openFile.get()] = openFile;
 
-			_openFiles[zipFilePtr] = openFile;
+			reportOpenedEntry(entryIndex);
 
 			return openFile;
 		}
 
-		void closeEntry(ZipFileHandle::RawPtr zipFilePtr)
+		// Opens an entry that is not encrypted for reading its data as it is
+		// stored in the archive. libzip neither decompresses nor checks the data,
+		// so the caller verifies it if needed.
+		ZipFileHandle::SharedPtr openRawEntry(zip_int64_t entryIndex)
 		{
-			_openFiles.erase(zipFilePtr);
+			MetricsTimer timer(MetricId::OpenEntryTime);
+
+			zip_file_t* zipFilePtr = zip_fopen_index(
+				get(),
+				entryIndex,
+				ZIP_FL_COMPRESSED
+			);
+
+			if (!zipFilePtr) {
+
+				throw std::runtime_error(
+					std::string("cannot open archive entry for reading -> ")
+						+ zip_strerror(get())
+				);
+
+			}
+
+			auto openFile = std::allocate_shared<
+				ZipFileHandle
+			>(getOwningAllocator(), zipFilePtr);
+
+			_openFiles[openFile.get()] = openFile;
+
+			reportOpenedEntry(entryIndex);
+
+			return openFile;
+		}
+
+		void closeEntry(const ZipFileHandle* fileHandle)
+		{
+			_openFiles.erase(fileHandle);
+		}
+
+		// opens an entry for reading without registering it, see EntryReader
+		EntryReader openEntryReader(
+			zip_int64_t entryIndex,
+			const std::string& entryPwd = ""
+		)
+		{
+			MetricsTimer timer(MetricId::OpenEntryTime);
+
+			zip_file_t* zipFilePtr = entryPwd.empty()
+				? zip_fopen_index(get(), entryIndex, 0)
+				: zip_fopen_index_encrypted(get(), entryIndex, 0, entryPwd.c_str());
+
+			if (!zipFilePtr) {
+
+				throw std::runtime_error(
+					std::string("cannot open archive entry for reading -> ")
+						+ zip_strerror(get())
+				);
+
+			}
+
+			reportOpenedEntry(entryIndex);
+
+			return EntryReader(zipFilePtr);
 		}
 
 	private:
 
+		// released after everything the handle allocated from it
+		MemoryResource::SharedPtr _resource;
+
 		RawPtr _zipPtr;
 		SourceStream::SharedPtr _sourcePtr;
 		bool _hasBeenSaved;
@@ -272,10 +684,59 @@ namespace Zip {
 		> _attachedSourcesForSaving;
 
 		std::map<
-			ZipFileHandle::RawPtr,
-			ZipFileHandle::SharedPtr
-		> _openFiles;
+			zip_uint64_t,
+			PendingEntry
+		> _pendingEntries;
+
+		// archives whose entries are copied when saving
+		std::vector<SharedPtr> _copySources;
+
+		EntryNameIndex _nameIndex;
+		std::unordered_set<std::string> _reservedNames;
+		CompressionPolicy _defaultCompression;
+
+		typedef std::map<
+			const ZipFileHandle*,
+			ZipFileHandle::SharedPtr,
+			std::less<const ZipFileHandle*>,
+			ResourceAllocator<
+				std::pair<const ZipFileHandle* const, ZipFileHandle::SharedPtr>
+			>
+		> OpenFileMap;
+
+		OpenFileMap _openFiles;
+
+		void checkReservedName(const std::string& entryPath)
+		{
+			if (_reservedNames.count(entryPath) > 0) {
+				throw std::runtime_error("entry already exists -> " + entryPath);
+			}
+		}
+
+		void reportOpenedEntry(zip_int64_t entryIndex)
+		{
+			Metrics::addCount(MetricId::EntryOpens);
+
+			if (!Metrics::Enabled) {
+				return;
+			}
+
+			struct zip_stat stat;
+
+			if (zip_stat_index(_zipPtr, entryIndex, 0, &stat) != 0) {
+				return;
+			}
+
+			if ((stat.valid & ZIP_STAT_SIZE) && (stat.valid & ZIP_STAT_COMP_SIZE)) {
+				Metrics::addEntrySizes(
+					(stat.valid & ZIP_STAT_NAME) ? stat.name : "",
+					stat.size,
+					stat.comp_size
+				);
+			}
+		}
 
 	};
 
+}
 }
\ No newline at end of file
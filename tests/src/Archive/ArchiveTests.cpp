@@ -2,6 +2,20 @@
 #include "../VsTestExplorer.h"
 
 #include <ZipCpp/ZipCpp.h>
+#include <ZipCpp/ParallelCompressor.h>
+#include <ZipCpp/InflateIndex.h>
+#include <ZipCpp/LazyArchive.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <functional>
+#include <future>
+#include <numeric>
+#include <thread>
 
 BOOST_AUTO_TEST_SUITE(Archive__Archive)
 
@@ -45,4 +59,1883 @@ BOOST_AUTO_TEST_CASE(testImportExport)
 
 }
 
+BOOST_AUTO_TEST_CASE(testSpooledImport)
+{
+
+	std::stringstream ss;
+	std::string content(100000, 'x');
+
+	for (std::size_t i = 0; i < content.size(); i += 7) {
+		content[i] = (char) ('a' + i % 26);
+	}
+
+	// the contents over the limit go to a temporary file
+
+	for (std::size_t limit : { (std::size_t) 4096, content.size() }) {
+
+		Zip::SpoolStream spool(limit);
+
+		spool.write(content.data(), 1000);
+		BOOST_TEST(!spool.isSpilled());
+
+		spool.write(content.data() + 1000, content.size() - 1000);
+		BOOST_TEST(spool.isSpilled() == (limit < content.size()));
+		BOOST_TEST(spool.size() == content.size());
+
+		std::string result(content.size(), '\0');
+
+		spool.rewind();
+		spool.read(&result[0], result.size());
+
+		BOOST_TEST(spool.good());
+		BOOST_TEST(result == content);
+
+		spool.read(&result[0], 1);
+
+		BOOST_TEST(spool.gcount() == 0);
+		BOOST_TEST(spool.eof());
+	}
+
+	// import an entry larger than the in-memory window
+
+	{
+		auto ar = Zip::MakeOutputArchive(&ss);
+
+		ar.setEntryBufferLimit(4096);
+
+		std::istringstream test(content);
+
+		ar.entry("test.txt") << test;
+		ar.saveAndClose();
+	}
+
+	// export the entry
+
+	{
+		auto ar = Zip::MakeInputArchive(&ss);
+
+		std::ostringstream test;
+
+		ar.entry("test.txt") >> test;
+
+		BOOST_TEST(test.str() == content);
+	}
+
+}
+
+BOOST_AUTO_TEST_CASE(testParallelCompression)
+{
+
+	std::vector<std::string> contents;
+
+	contents.push_back("");
+	contents.push_back("Hi!");
+	contents.push_back(std::string(200000, 'a'));
+
+	std::string text;
+
+	for (int i = 0; i < 20000; i++) {
+		text += std::to_string(i * 7919 % 10007) + " ";
+	}
+
+	contents.push_back(text);
+
+	auto save = [&contents](std::stringstream& ss, bool parallel)
+	{
+		auto ar = Zip::MakeOutputArchive(&ss);
+
+		for (std::size_t i = 0; i < contents.size(); i++) {
+			std::istringstream is(contents[i]);
+			ar.entry("test" + std::to_string(i) + ".txt") << is;
+		}
+
+		if (parallel) {
+			ar.saveAndClose(Zip::ParallelCompressor(4));
+		}
+		else {
+			ar.saveAndClose();
+		}
+	};
+
+	std::stringstream serial;
+	std::stringstream parallel;
+
+	save(serial, false);
+	save(parallel, true);
+
+	// the entries are the same as the ones libzip writes,
+	// the compressed data itself may differ
+	auto serialAr = Zip::MakeInputArchive(&serial);
+	auto parallelAr = Zip::MakeInputArchive(&parallel);
+
+	auto serialList = serialAr.getEntryList();
+	auto parallelList = parallelAr.getEntryList();
+
+	BOOST_TEST(serialList.size() == parallelList.size());
+
+	for (std::size_t i = 0; i < serialList.size(); i++) {
+		BOOST_TEST(std::string(serialList[i].name) == parallelList[i].name);
+		BOOST_TEST(serialList[i].comp_method == parallelList[i].comp_method);
+		BOOST_TEST(serialList[i].size == parallelList[i].size);
+		BOOST_TEST(serialList[i].crc == parallelList[i].crc);
+	}
+
+	for (std::size_t i = 0; i < contents.size(); i++) {
+		std::ostringstream os;
+		parallelAr.entry("test" + std::to_string(i) + ".txt") >> os;
+		BOOST_TEST(os.str() == contents[i]);
+	}
+
+}
+
+BOOST_AUTO_TEST_CASE(testParallelCompressionFailure)
+{
+
+	// fails the first read of the data
+	class FlakyBuffer : public std::stringbuf {
+	public:
+
+		FlakyBuffer(const std::string& data) :
+			std::stringbuf(data, std::ios_base::in),
+			_hasFailed(false)
+		{}
+
+	protected:
+
+		std::streamsize xsgetn(char* s, std::streamsize n) override
+		{
+			if (!_hasFailed) {
+				_hasFailed = true;
+				throw std::runtime_error("read failure");
+			}
+
+			return std::stringbuf::xsgetn(s, n);
+		}
+
+	private:
+
+		bool _hasFailed;
+
+	};
+
+	std::string text;
+
+	for (int i = 0; i < 20000; i++) {
+		text += std::to_string(i * 7919 % 10007) + " ";
+	}
+
+	FlakyBuffer buffer(text);
+	std::istream flaky(&buffer);
+
+	std::stringstream ss;
+
+	{
+		auto ar = Zip::MakeOutputArchive(&ss);
+
+		std::istringstream is("Hi!");
+		ar.entry("test0.txt") << is;
+
+		ar.addEntry("test1.txt", &flaky, Zip::CompressionPolicy(ZIP_CM_DEFLATE, 9));
+
+		BOOST_CHECK_THROW(ar.saveAndClose(Zip::ParallelCompressor(2)), std::runtime_error);
+
+		// the data that has been read is read once more from the beginning
+		ar.saveAndClose();
+	}
+
+	auto ar = Zip::MakeInputArchive(&ss);
+
+	std::ostringstream os0;
+	ar.entry("test0.txt") >> os0;
+	BOOST_TEST(os0.str() == "Hi!");
+
+	std::ostringstream os1;
+	ar.entry("test1.txt") >> os1;
+	BOOST_TEST(os1.str() == text);
+
+}
+
+BOOST_AUTO_TEST_CASE(testParallelBlockCompression)
+{
+
+	std::vector<std::string> contents;
+
+	std::string text;
+
+	for (int i = 0; i < 100000; i++) {
+		text += std::to_string(i * 7919 % 10007) + " ";
+	}
+
+	contents.push_back("Hi!");
+	contents.push_back(text);
+	// the serial part takes 131072 bytes, the rest ends on a block boundary
+	contents.push_back(std::string(131072 + 3 * 65536, 'a'));
+
+	std::stringstream ss;
+
+	{
+		auto ar = Zip::MakeOutputArchive(&ss);
+
+		for (std::size_t i = 0; i < contents.size(); i++) {
+			std::istringstream is(contents[i]);
+			ar.entry("test" + std::to_string(i) + ".txt") << is;
+		}
+
+		Zip::ParallelCompressor compressor(4);
+		compressor.setBlockSplitting(100000, 65536);
+
+		ar.saveAndClose(compressor);
+	}
+
+	auto ar = Zip::MakeInputArchive(&ss);
+	auto entryList = ar.getEntryList();
+
+	for (std::size_t i = 0; i < contents.size(); i++) {
+
+		std::ostringstream os;
+		ar.entry("test" + std::to_string(i) + ".txt") >> os;
+
+		BOOST_TEST(os.str() == contents[i]);
+		BOOST_TEST(entryList[i].crc == crc32(
+			0L,
+			reinterpret_cast<const Bytef*>(contents[i].data()),
+			(uInt) contents[i].size()
+		));
+
+	}
+
+	// the blocks are primed with the previous ones, so the data still shrinks
+	BOOST_TEST(entryList[1].comp_size < entryList[1].size / 2);
+
+}
+
+BOOST_AUTO_TEST_CASE(testMappedInputArchive)
+{
+
+	const char* filePath = "testMappedInputArchive.zip";
+
+	{
+		std::ofstream fs(filePath, std::ios::binary);
+		auto ar = Zip::MakeOutputArchive(&fs);
+
+		std::istringstream test1("Hello!");
+		std::istringstream test2(std::string(100000, 'z'));
+
+		ar.entry("test1.txt") << test1;
+		ar.entry("test2.txt") << test2;
+
+		ar.saveAndClose();
+	}
+
+	{
+		auto ar = Zip::MakeMappedInputArchive(filePath);
+
+		std::ostringstream test1;
+		std::ostringstream test2;
+
+		ar.entry("test1.txt") >> test1;
+		ar.entry("test2.txt") >> test2;
+
+		BOOST_TEST(test1.str() == "Hello!");
+		BOOST_TEST(test2.str() == std::string(100000, 'z'));
+	}
+
+	std::remove(filePath);
+
+	BOOST_CHECK_THROW(
+		Zip::MakeMappedInputArchive(filePath).getEntryList(),
+		std::runtime_error
+	);
+
+}
+
+BOOST_AUTO_TEST_CASE(testEntryLookup)
+{
+
+	std::stringstream ss;
+
+	{
+		auto ar = Zip::MakeOutputArchive(&ss);
+
+		std::istringstream test1("Hello!");
+		std::istringstream test2("Hi!");
+
+		ar.entry("Dir/Test1.txt") << test1;
+
+		// the index is built by the first lookup and updated when adding entries
+		BOOST_TEST(ar.entry("dir/test1.txt").getIndex() == 0);
+		BOOST_TEST(!ar.entry("Dir/Test2.txt"));
+
+		ar.entry("Dir/Test2.txt") << test2;
+
+		BOOST_TEST(ar.entry("DIR/TEST2.TXT").getIndex() == 1);
+
+		ar.saveAndClose();
+	}
+
+	{
+		auto ar = Zip::MakeInputArchive(&ss);
+
+		BOOST_TEST(ar.entry("dir/test1.txt").getIndex() == 0);
+		BOOST_TEST(ar.entry("Dir/Test2.txt", "", 0).getIndex() == 1);
+		BOOST_TEST(!ar.entry("dir/test2.txt", "", 0));
+		BOOST_TEST(ar.entry("test2.txt", "", ZIP_FL_NODIR).getIndex() == 1);
+		BOOST_TEST(!ar.entry("test3.txt"));
+	}
+
+}
+
+BOOST_AUTO_TEST_CASE(testEntryTable)
+{
+
+	std::stringstream ss;
+
+	{
+		auto ar = Zip::MakeOutputArchive(&ss);
+
+		std::istringstream test1("Hello!");
+		std::istringstream test2("Hi!");
+
+		ar.entry("test1.txt") << test1;
+		ar.entry("test2.txt") << test2;
+
+		ar.saveAndClose();
+	}
+
+	auto ar = Zip::MakeInputArchive(&ss);
+
+	auto entryList = ar.getEntryList();
+	auto entryTable = ar.getEntryTable();
+
+	BOOST_TEST(entryList.size() == 2);
+	BOOST_TEST(entryTable.size() == 2);
+
+	for (std::size_t i = 0; i < entryList.size(); i++) {
+		BOOST_TEST(std::string(entryTable.getName(i)) == entryList[i].name);
+		BOOST_TEST(entryTable.getIndex(i) == entryList[i].index);
+		BOOST_TEST(entryTable.getSize(i) == entryList[i].size);
+		BOOST_TEST(entryTable.getCompSize(i) == entryList[i].comp_size);
+		BOOST_TEST(entryTable.getCrc(i) == entryList[i].crc);
+		BOOST_TEST(entryTable.getCompMethod(i) == entryList[i].comp_method);
+	}
+
+	zip_uint64_t totalSize = 0;
+
+	ar.forEachEntry(
+		[&totalSize](const Zip::Archive::EntryInfo& info)
+		{
+			totalSize += info.size;
+		}
+	);
+
+	BOOST_TEST(totalSize == 9u);
+
+}
+
+BOOST_AUTO_TEST_CASE(testCompressionPolicy)
+{
+
+	std::stringstream ss;
+
+	std::string text(100000, 't');
+	std::string noise;
+
+	for (unsigned i = 0, x = 1; i < 100000; i++) {
+		x = x * 1103515245 + 12345;
+		noise += (char) (x >> 16);
+	}
+
+	{
+		auto ar = Zip::MakeOutputArchive(&ss);
+
+		ar.setCompression(Zip::CompressionPolicy::Auto());
+
+		std::istringstream test1(text);
+		std::istringstream test2(noise);
+		std::istringstream test3(text);
+		std::istringstream test4(text);
+
+		ar.entry("test1.txt") << test1;
+		ar.entry("test2.bin") << test2;
+		ar.entry("test3.txt").setCompression(Zip::CompressionPolicy::Store()) << test3;
+		ar.addEntry("test4.txt", &test4, Zip::CompressionPolicy(ZIP_CM_DEFLATE, 1));
+
+		ar.saveAndClose();
+	}
+
+	auto ar = Zip::MakeInputArchive(&ss);
+	auto entryList = ar.getEntryList();
+
+	BOOST_TEST(entryList.size() == 4);
+	BOOST_TEST(entryList[0].comp_method == ZIP_CM_DEFLATE);
+	BOOST_TEST(entryList[1].comp_method == ZIP_CM_STORE);
+	BOOST_TEST(entryList[2].comp_method == ZIP_CM_STORE);
+	BOOST_TEST(entryList[3].comp_method == ZIP_CM_DEFLATE);
+
+	std::ostringstream test2;
+	ar.entry("test2.bin") >> test2;
+	BOOST_TEST(test2.str() == noise);
+
+}
+
+BOOST_AUTO_TEST_CASE(testExportToSink)
+{
+
+	std::stringstream ss;
+	std::string content(300000, 's');
+
+	{
+		auto ar = Zip::MakeOutputArchive(&ss);
+
+		ar.setCopyBufferSize(64 * 1024);
+
+		std::istringstream test(content);
+
+		ar.entry("test.txt") << test;
+		ar.saveAndClose();
+	}
+
+	auto ar = Zip::MakeInputArchive(&ss);
+
+	std::string exported;
+	std::size_t numOfChunks = 0;
+
+	ar.entry("test.txt").exportTo(
+		[&exported, &numOfChunks](const char* data, std::size_t len)
+		{
+			exported.append(data, len);
+			numOfChunks++;
+		}
+	);
+
+	BOOST_TEST(exported == content);
+	BOOST_TEST(numOfChunks >= 2u);
+
+}
+
+BOOST_AUTO_TEST_CASE(testConcurrentReads)
+{
+
+	const char* filePath = "testConcurrentReads.zip";
+	const int numOfEntries = 16;
+
+	{
+		std::ofstream fs(filePath, std::ios::binary);
+		auto ar = Zip::MakeOutputArchive(&fs);
+
+		for (int i = 0; i < numOfEntries; i++) {
+			std::istringstream test(std::string(10000 + i, 'a' + i));
+			ar.entry("test" + std::to_string(i) + ".txt") << test;
+		}
+
+		ar.saveAndClose();
+	}
+
+	{
+		auto ar = Zip::MakeConcurrentMappedInputArchive(filePath, 2);
+
+		BOOST_TEST(ar.getEntryList().size() == (std::size_t) numOfEntries);
+
+		std::vector<std::string> results(numOfEntries * 4);
+		std::vector<std::thread> threads;
+
+		for (int t = 0; t < 4; t++) {
+
+			threads.emplace_back([&ar, &results, t, numOfEntries]() {
+
+				for (int i = 0; i < numOfEntries; i++) {
+
+					std::ostringstream os;
+
+					if (i % 2) {
+						ar.exportTo("test" + std::to_string(i) + ".txt", os);
+					}
+					else {
+						auto is = ar.openForReading("test" + std::to_string(i) + ".txt");
+						char buf[4096];
+
+						while (is->read(buf, sizeof(buf)), is->good()) {
+							os.write(buf, is->gcount());
+						}
+					}
+
+					results[t * numOfEntries + i] = os.str();
+				}
+
+			});
+
+		}
+
+		for (auto& thread : threads) {
+			thread.join();
+		}
+
+		for (int t = 0; t < 4; t++) {
+			for (int i = 0; i < numOfEntries; i++) {
+				BOOST_TEST(results[t * numOfEntries + i] == std::string(10000 + i, 'a' + i));
+			}
+		}
+	}
+
+	std::remove(filePath);
+
+}
+
+BOOST_AUTO_TEST_CASE(testExtractAll)
+{
+
+	const char* filePath = "testExtractAll.zip";
+
+	{
+		std::ofstream fs(filePath, std::ios::binary);
+		auto ar = Zip::MakeOutputArchive(&fs);
+
+		std::istringstream test1("Hello!");
+		std::istringstream test2(std::string(100000, 'z'));
+		std::istringstream test3("unsafe");
+
+		ar.entry("test1.txt") << test1;
+		ar.entry("dir/sub/test2.txt") << test2;
+		ar.entry("../test3.txt") << test3;
+
+		ar.saveAndClose();
+	}
+
+	auto readFile = [](const std::string& path)
+	{
+		std::ifstream fs(path, std::ios::binary);
+		std::ostringstream ss;
+		ss << fs.rdbuf();
+		return ss.str();
+	};
+
+	auto removeAll = [](const std::string& destDir)
+	{
+		std::remove((destDir + "/test1.txt").c_str());
+		std::remove((destDir + "/dir/sub/test2.txt").c_str());
+		std::remove((destDir + "/dir/sub").c_str());
+		std::remove((destDir + "/dir").c_str());
+		std::remove(destDir.c_str());
+	};
+
+	for (int concurrent = 0; concurrent < 2; concurrent++) {
+
+		const std::string destDir = "testExtractAll";
+
+		Zip::ExtractOptions options;
+		options.numOfThreads = 2;
+
+		Zip::ExtractResultList results;
+
+		if (concurrent) {
+			results = Zip::MakeConcurrentArchiveFile(filePath).extractAll(destDir, options);
+		}
+		else {
+			results = Zip::ArchiveFile(filePath, Zip::ArchiveFile::Mode::ReadOnly).extractAll(destDir, options);
+		}
+
+		BOOST_TEST(results.size() == 3u);
+
+		BOOST_TEST(results[0].success);
+		BOOST_TEST(results[1].success);
+		BOOST_TEST(!results[2].success);
+		BOOST_TEST(results[2].entryPath == "../test3.txt");
+
+		BOOST_TEST(readFile(destDir + "/test1.txt") == "Hello!");
+		BOOST_TEST(readFile(destDir + "/dir/sub/test2.txt") == std::string(100000, 'z'));
+
+		options.overwrite = false;
+
+		results = Zip::ArchiveFile(filePath, Zip::ArchiveFile::Mode::ReadOnly).extractAll(destDir, options);
+
+		BOOST_TEST(!results[0].success);
+		BOOST_TEST(readFile(destDir + "/test1.txt") == "Hello!");
+
+		removeAll(destDir);
+	}
+
+	std::remove(filePath);
+
+}
+
+BOOST_AUTO_TEST_CASE(testExtractConflicts)
+{
+
+	// serves the entries from memory
+	struct EntryArchive {
+
+		struct Entry {
+
+			const std::string& data;
+
+			void exportTo(const std::function<void(const char*, std::size_t)>& write)
+			{
+				write(data.data(), data.size());
+			}
+
+		};
+
+		std::vector<std::string> contents;
+
+		Entry entryAt(zip_uint64_t index, const std::string&)
+		{
+			return Entry{ contents[index] };
+		}
+
+	};
+
+	EntryArchive archive;
+	archive.contents = { "first", "x", "second", "y" };
+
+	const std::vector<std::string> names = {
+		"test.txt", "blocker/x.txt", "test.txt", "blocker/"
+	};
+
+	Zip::Extractor::EntryList entryList(names.size());
+
+	for (std::size_t i = 0; i < names.size(); i++) {
+		zip_stat_init(&entryList[i]);
+		entryList[i].valid = ZIP_STAT_INDEX | ZIP_STAT_NAME | ZIP_STAT_SIZE;
+		entryList[i].index = i;
+		entryList[i].name = names[i].c_str();
+		entryList[i].size = archive.contents[i].size();
+	}
+
+	const std::string destDir = "testExtractConflicts";
+
+	for (bool overwrite : { true, false }) {
+
+		// creates the directory
+		Zip::Extractor(destDir, Zip::Extractor::EntryList());
+
+		// a file stands where the directory should be
+		std::ofstream(destDir + "/blocker") << "file";
+
+		Zip::ExtractOptions options;
+		options.overwrite = overwrite;
+
+		Zip::Extractor extractor(destDir, entryList, options);
+
+		// entries of the same name are extracted one after another
+		BOOST_TEST(extractor.getNumOfTasks() == 1u);
+
+		for (std::size_t i = 0; i < extractor.getNumOfTasks(); i++) {
+			extractor.extract(i, archive);
+		}
+
+		auto& results = extractor.getResults();
+
+		BOOST_TEST(results[0].success);
+		BOOST_TEST(results[2].success == overwrite);
+
+		// the failed directory does not stop the other entries
+		BOOST_TEST(!results[1].success);
+		BOOST_TEST(!results[3].success);
+		BOOST_TEST(results[1].error.find("cannot create directory") == 0u);
+
+		std::ifstream fs(destDir + "/test.txt");
+		std::string content;
+		fs >> content;
+
+		BOOST_TEST(content == (overwrite ? "second" : "first"));
+
+		fs.close();
+
+		std::remove((destDir + "/test.txt").c_str());
+		std::remove((destDir + "/blocker").c_str());
+		std::remove(destDir.c_str());
+	}
+
+}
+
+BOOST_AUTO_TEST_CASE(testEntrySeek)
+{
+
+	std::string content;
+
+	for (int i = 0; i < 100000; i++) {
+		content += (char) ('a' + i % 26);
+	}
+
+	std::stringstream ss;
+
+	{
+		auto ar = Zip::MakeOutputArchive(&ss);
+
+		std::istringstream test1(content);
+		std::istringstream test2(content);
+
+		ar.entry("stored.txt").setCompression(Zip::CompressionPolicy::Store()) << test1;
+		ar.entry("deflated.txt") << test2;
+
+		ar.saveAndClose();
+	}
+
+	auto ar = Zip::MakeInputArchive(&ss);
+
+	for (const char* entryPath : { "stored.txt", "deflated.txt" }) {
+
+		auto is = ar.entry(entryPath).openForReading();
+
+		char buf[10];
+
+		// footer
+		is->seekg(-10, std::ios_base::end);
+		BOOST_TEST(is->tellg() == (zip_int64_t) content.size() - 10);
+
+		is->read(buf, sizeof(buf));
+		BOOST_TEST(std::string(buf, is->gcount()) == content.substr(content.size() - 10));
+
+		// backwards
+		is->seekg(500);
+		is->read(buf, sizeof(buf));
+		BOOST_TEST(std::string(buf, is->gcount()) == content.substr(500, 10));
+		BOOST_TEST(is->tellg() == 510);
+
+		// forwards from the current position
+		is->seekg(1000, std::ios_base::cur);
+		is->read(buf, sizeof(buf));
+		BOOST_TEST(std::string(buf, is->gcount()) == content.substr(1510, 10));
+
+		is->seekg(content.size() + 1);
+		BOOST_TEST(is->fail());
+		BOOST_TEST(is->tellg() == -1);
+	}
+
+}
+
+BOOST_AUTO_TEST_CASE(testEntrySeekCheckpoints)
+{
+
+	std::string content;
+	unsigned x = 1;
+
+	while (content.size() < 3 * 1024 * 1024) {
+		x = x * 1103515245 + 12345;
+		content += std::to_string((x >> 16) % 1000) + " ";
+	}
+
+	std::stringstream ss;
+
+	{
+		auto ar = Zip::MakeOutputArchive(&ss);
+
+		std::istringstream test1(content);
+		std::istringstream test2(content);
+
+		ar.entry("stored.txt").setCompression(Zip::CompressionPolicy::Store()) << test1;
+		ar.entry("deflated.txt") << test2;
+
+		ar.saveAndClose();
+	}
+
+	auto ar = Zip::MakeInputArchive(&ss);
+
+	std::shared_ptr<Zip::InflateIndex> index;
+	auto factory = Zip::InflateIndex::makeFactory(256 * 1024);
+
+	ar.setEntryDecoder(
+		[&index, factory](const Zip::Archive::EntryInfo& stat)
+		{
+			auto decoder = factory(stat);
+			index = std::dynamic_pointer_cast<Zip::InflateIndex>(decoder);
+			return decoder;
+		}
+	);
+
+	{
+		// stored entries are not decoded
+		std::ostringstream test;
+		ar.entry("stored.txt") >> test;
+
+		BOOST_TEST(!index);
+		BOOST_TEST(test.str() == content);
+	}
+
+	{
+		// the crc is checked when read in sequence
+		std::ostringstream test;
+		ar.entry("deflated.txt") >> test;
+
+		BOOST_TEST(test.str() == content);
+	}
+
+	auto is = ar.entry("deflated.txt").openForReading();
+
+	BOOST_REQUIRE(index);
+
+	char buf[100];
+
+	// footer, the checkpoints are recorded on the way
+	is->seekg(-100, std::ios_base::end);
+	is->read(buf, sizeof(buf));
+	BOOST_TEST(std::string(buf, is->gcount()) == content.substr(content.size() - 100));
+	BOOST_TEST(index->getNumOfCheckpoints() >= 10u);
+
+	// backwards, each from the nearest checkpoint
+	for (std::size_t pos : { 2500000, 1000000, 1000001, 300000, 17, 0, 2900000 }) {
+		is->seekg(pos);
+		is->read(buf, sizeof(buf));
+		BOOST_TEST(is->tellg() == (zip_int64_t) pos + 100);
+		BOOST_TEST(std::string(buf, is->gcount()) == content.substr(pos, 100));
+	}
+
+	is->seekg(content.size() + 1);
+	BOOST_TEST(is->fail());
+
+}
+
+BOOST_AUTO_TEST_CASE(testBufferedOutput)
+{
+
+	struct CountingStream : std::stringstream {
+
+		std::size_t numOfWrites = 0;
+		std::size_t numOfTells = 0;
+
+		CountingStream& write(const char* s, std::streamsize n)
+		{
+			numOfWrites++;
+			std::stringstream::write(s, n);
+			return *this;
+		}
+
+		std::streampos tellp()
+		{
+			numOfTells++;
+			return std::stringstream::tellp();
+		}
+
+	};
+
+	for (std::size_t writeBufferSize : { (std::size_t) 0, (std::size_t) 64 * 1024 }) {
+
+		CountingStream ss;
+
+		{
+			auto ar = Zip::MakeOutputArchive(&ss, writeBufferSize);
+
+			for (int i = 0; i < 100; i++) {
+				std::istringstream test("Hello " + std::to_string(i));
+				ar.entry("test" + std::to_string(i) + ".txt") << test;
+			}
+
+			ar.saveAndClose();
+		}
+
+		BOOST_TEST(ss.numOfTells <= 1u);
+
+		if (writeBufferSize > 0) {
+			BOOST_TEST(ss.numOfWrites <= 2u);
+		}
+
+		auto ar = Zip::MakeInputArchive(&ss);
+
+		BOOST_TEST(ar.getNumOfEntries() == 100u);
+
+		std::ostringstream test;
+		ar.entry("test42.txt") >> test;
+
+		BOOST_TEST(test.str() == "Hello 42");
+	}
+
+}
+
+BOOST_AUTO_TEST_CASE(testAsyncArchive)
+{
+
+	Zip::ThreadPool threadPool(2);
+
+	std::stringstream ss;
+
+	{
+		Zip::AsyncArchive ar(Zip::MakeSharedOutputArchive(&ss), threadPool);
+
+		ar.post(
+			[](Zip::Archive& archive)
+			{
+				std::istringstream test1("Hello!");
+				std::istringstream test2(std::string(100000, 'z'));
+
+				archive.entry("test1.txt") << test1;
+				archive.entry("test2.txt") << test2;
+			},
+			[](std::exception_ptr) {}
+		);
+
+		std::promise<std::exception_ptr> saved;
+
+		ar.asyncSaveAndClose(
+			[&saved](std::exception_ptr error)
+			{
+				saved.set_value(error);
+			}
+		);
+
+		BOOST_TEST(!saved.get_future().get());
+	}
+
+	Zip::AsyncArchive ar(Zip::MakeSharedInputArchive(&ss), threadPool);
+
+	std::string exported;
+	std::promise<std::exception_ptr> done;
+
+	ar.asyncExportTo(
+		"test2.txt",
+		[&exported](const char* data, std::size_t len)
+		{
+			exported.append(data, len);
+		},
+		[&done](std::exception_ptr error)
+		{
+			done.set_value(error);
+		}
+	);
+
+	BOOST_TEST(!done.get_future().get());
+	BOOST_TEST(exported == std::string(100000, 'z'));
+
+	std::promise<Zip::ReadableEntryStream::SharedPtr> opened;
+
+	ar.asyncOpenForReading(
+		"test1.txt",
+		[&opened](std::exception_ptr, Zip::ReadableEntryStream::SharedPtr stream)
+		{
+			opened.set_value(stream);
+		}
+	);
+
+	auto stream = opened.get_future().get();
+	BOOST_TEST(bool(stream));
+
+	char buf[100];
+	std::promise<std::size_t> read;
+
+	ar.asyncRead(
+		stream,
+		buf,
+		sizeof(buf),
+		[&read](std::exception_ptr, std::size_t nread)
+		{
+			read.set_value(nread);
+		}
+	);
+
+	BOOST_TEST(std::string(buf, read.get_future().get()) == "Hello!");
+
+	std::promise<std::exception_ptr> missing;
+
+	ar.asyncOpenForReading(
+		"missing.txt",
+		[&missing](std::exception_ptr error, Zip::ReadableEntryStream::SharedPtr)
+		{
+			missing.set_value(error);
+		}
+	);
+
+	BOOST_TEST(bool(missing.get_future().get()));
+
+	// a throwing handler does not stop the following operations
+	ar.post(
+		[](Zip::Archive&) {},
+		[](std::exception_ptr)
+		{
+			throw std::runtime_error("handler failed");
+		}
+	);
+
+	std::promise<std::exception_ptr> next;
+
+	ar.post(
+		[](Zip::Archive&) {},
+		[&next](std::exception_ptr error)
+		{
+			next.set_value(error);
+		}
+	);
+
+	BOOST_TEST(!next.get_future().get());
+
+}
+
+BOOST_AUTO_TEST_CASE(testAppendMode)
+{
+
+	const char* filePath = "testAppendMode.zip";
+
+	std::remove(filePath);
+
+	{
+		Zip::ArchiveFile ar(filePath, Zip::ArchiveFile::Mode::Create);
+
+		std::istringstream test1("Hello!");
+		ar.entry("test1.txt") << test1;
+
+		ar.saveAndClose();
+	}
+
+	auto readFile = [filePath]()
+	{
+		std::ifstream fs(filePath, std::ios::binary);
+		std::ostringstream ss;
+		ss << fs.rdbuf();
+		return ss.str();
+	};
+
+	for (int i = 2; i <= 3; i++) {
+
+		std::string original = readFile();
+
+		Zip::ArchiveFile ar(filePath, Zip::ArchiveFile::Mode::Append);
+
+		BOOST_TEST(ar.getNumOfEntries() == 0u);
+
+		std::istringstream test(std::string(10000 * i, 'a' + i));
+		ar.entry("test" + std::to_string(i) + ".txt") << test;
+
+		ar.saveAndClose();
+
+		// the original contents are kept as they were
+		BOOST_TEST(readFile().compare(0, original.size(), original) == 0);
+	}
+
+	{
+		std::string original = readFile();
+
+		Zip::ArchiveFile ar(filePath, Zip::ArchiveFile::Mode::Append);
+
+		// refused before its data is written
+		std::istringstream test("duplicate");
+		BOOST_CHECK_THROW(ar.entry("test1.txt") << test, std::runtime_error);
+
+		ar.saveAndClose();
+
+		BOOST_TEST(readFile() == original);
+	}
+
+	{
+		Zip::ArchiveFile ar(filePath, Zip::ArchiveFile::Mode::ReadOnly);
+
+		BOOST_TEST(ar.getNumOfEntries() == 3u);
+
+		std::ostringstream test1;
+		std::ostringstream test2;
+		std::ostringstream test3;
+
+		ar.entry("test1.txt") >> test1;
+		ar.entry("test2.txt") >> test2;
+		ar.entry("test3.txt") >> test3;
+
+		BOOST_TEST(test1.str() == "Hello!");
+		BOOST_TEST(test2.str() == std::string(20000, 'c'));
+		BOOST_TEST(test3.str() == std::string(30000, 'd'));
+	}
+
+	std::remove(filePath);
+
+}
+
+BOOST_AUTO_TEST_CASE(testSourceDispatch)
+{
+
+	typedef Zip::ReadableSourceStream<std::istream*> Readable;
+	typedef Zip::SeekableSourceStream<std::istream*> Seekable;
+	typedef Zip::WritableSourceStream<std::istream*, std::ostream*> Writable;
+
+	// the supported commands are known at compile time
+	static_assert(
+		(Zip::SourceDispatcher<Readable>::Supports & ZIP_SOURCE_MAKE_COMMAND_BITMASK(ZIP_SOURCE_SEEK)) == 0,
+		"readable source streams cannot seek"
+	);
+
+	BOOST_TEST(Zip::SourceDispatcher<Readable>::Supports == zip_source_make_command_bitmap(
+		ZIP_READABLE_SOURCE_STREAM_SUPPORTS,
+		-1
+	));
+
+	BOOST_TEST(Zip::SourceDispatcher<Seekable>::Supports == zip_source_make_command_bitmap(
+		ZIP_READABLE_SOURCE_STREAM_SUPPORTS,
+		ZIP_SEEKABLE_SOURCE_STREAM_SUPPORTS,
+		-1
+	));
+
+	BOOST_TEST(Zip::SourceDispatcher<Writable>::Supports == zip_source_make_command_bitmap(
+		ZIP_READABLE_SOURCE_STREAM_SUPPORTS,
+		ZIP_SEEKABLE_SOURCE_STREAM_SUPPORTS,
+		ZIP_WRITABLE_SOURCE_STREAM_SUPPORTS,
+		-1
+	));
+
+	BOOST_TEST(Zip::SourceDispatcher<Zip::PreparedSourceStream>::Supports == zip_source_make_command_bitmap(
+		ZIP_READABLE_SOURCE_STREAM_SUPPORTS,
+		ZIP_PREPARED_SOURCE_STREAM_SUPPORTS,
+		-1
+	));
+
+	// commands are served without going through the base classes
+
+	std::istringstream test("Hello!");
+	Readable src(&test);
+
+	char buff[16];
+
+	BOOST_TEST(Readable::dispatch(&src, nullptr, 0, ZIP_SOURCE_OPEN) == 0);
+	BOOST_TEST(Readable::dispatch(&src, buff, sizeof(buff), ZIP_SOURCE_READ) == 6);
+	BOOST_TEST(std::string(buff, 6) == "Hello!");
+	BOOST_TEST(Readable::dispatch(&src, nullptr, 0, ZIP_SOURCE_TELL) == -1);
+
+	int error[2];
+
+	BOOST_TEST(Readable::dispatch(&src, error, sizeof(error), ZIP_SOURCE_ERROR) > 0);
+	BOOST_TEST(error[0] == ZIP_ER_INVAL);
+
+	BOOST_TEST(Readable::dispatch(&src, nullptr, 0, ZIP_SOURCE_CLOSE) == 0);
+
+	// a derived class that relies on the base dispatch is still called
+	class UpperCase : public Readable {
+	public:
+
+		UpperCase(std::istream* inputStreamPtr) :
+			Readable(inputStreamPtr)
+		{}
+
+	protected:
+
+		zip_int64_t read(char* buff, zip_uint64_t len) override
+		{
+			zip_int64_t nread = Readable::read(buff, len);
+
+			for (zip_int64_t i = 0; i < nread; i++) {
+				buff[i] = (char) std::toupper((unsigned char) buff[i]);
+			}
+
+			return nread;
+		}
+
+	};
+
+	std::istringstream upperTest("Hello!");
+	UpperCase upper(&upperTest);
+
+	BOOST_TEST(Readable::dispatch(&upper, nullptr, 0, ZIP_SOURCE_OPEN) == 0);
+	BOOST_TEST(Readable::dispatch(&upper, buff, sizeof(buff), ZIP_SOURCE_READ) == 6);
+	BOOST_TEST(std::string(buff, 6) == "HELLO!");
+	BOOST_TEST(Readable::dispatch(&upper, nullptr, 0, ZIP_SOURCE_CLOSE) == 0);
+
+}
+
+BOOST_AUTO_TEST_CASE(testCopyEntries)
+{
+
+	std::stringstream ss1;
+
+	{
+		auto ar = Zip::MakeOutputArchive(&ss1);
+
+		std::istringstream test1(std::string(10000, 'a'));
+		std::istringstream test2(std::string(10000, 'b'));
+		std::istringstream test3("Hi!");
+
+		ar.entry("test1.txt") << test1;
+		ar.entry("dir/test2.txt") << test2;
+		ar.entry("dir/test3.txt") << test3;
+
+		ar.saveAndClose();
+	}
+
+	std::stringstream ss2;
+
+	{
+		auto source = Zip::MakeInputArchive(&ss1);
+		auto ar = Zip::MakeOutputArchive(&ss2);
+
+		ar.copyEntryFrom(source, "test1.txt", "copy.txt");
+
+		std::size_t numOfCopied = ar.mergeFrom(
+			source,
+			[](const Zip::Archive::EntryInfo& stat)
+			{
+				return std::string(stat.name).find("dir/") == 0;
+			}
+		);
+
+		BOOST_TEST(numOfCopied == 2u);
+		BOOST_CHECK_THROW(ar.copyEntryFrom(source, "test4.txt"), std::logic_error);
+
+		ar.saveAndClose();
+	}
+
+	auto source = Zip::MakeInputArchive(&ss1);
+	auto ar = Zip::MakeInputArchive(&ss2);
+
+	BOOST_TEST(ar.getNumOfEntries() == 3u);
+
+	std::ostringstream test1;
+	std::ostringstream test3;
+
+	ar.entry("copy.txt") >> test1;
+	ar.entry("dir/test3.txt") >> test3;
+
+	BOOST_TEST(test1.str() == std::string(10000, 'a'));
+	BOOST_TEST(test3.str() == "Hi!");
+
+	// the compressed data are the same
+	auto sourceList = source.getEntryList();
+	auto entryList = ar.getEntryList();
+
+	BOOST_TEST(entryList[0].comp_size == sourceList[0].comp_size);
+	BOOST_TEST(entryList[0].crc == sourceList[0].crc);
+	BOOST_TEST(entryList[1].comp_method == sourceList[1].comp_method);
+	BOOST_TEST(entryList[1].comp_size == sourceList[1].comp_size);
+
+}
+
+BOOST_AUTO_TEST_CASE(testMemoryArchive)
+{
+
+	std::vector<char> buffer(100, 'x');
+
+	{
+		auto ar = Zip::MakeOutputArchive(&buffer);
+
+		std::istringstream test1("Hello!");
+		std::istringstream test2(std::string(100000, 'z'));
+
+		ar.entry("test1.txt") << test1;
+		ar.entry("test2.txt") << test2;
+
+		ar.saveAndClose();
+	}
+
+	// the previous content is replaced
+	BOOST_TEST(buffer.size() > 4u);
+	BOOST_TEST(std::string(buffer.data(), 4) == std::string("PK\x03\x04", 4));
+
+	{
+		auto ar = Zip::MakeInputArchive(buffer.data(), buffer.size());
+
+		std::ostringstream test1;
+		std::ostringstream test2;
+
+		ar.entry("test1.txt") >> test1;
+		ar.entry("test2.txt") >> test2;
+
+		BOOST_TEST(test1.str() == "Hello!");
+		BOOST_TEST(test2.str() == std::string(100000, 'z'));
+	}
+
+	// the owner keeps the memory alive
+
+	auto data = std::make_shared<std::vector<char>>(buffer);
+
+	auto ar = Zip::MakeSharedInputArchive(data->data(), data->size(), data);
+
+	data.reset();
+
+	std::ostringstream test1;
+	ar->entry("test1.txt") >> test1;
+
+	BOOST_TEST(test1.str() == "Hello!");
+
+}
+
+BOOST_AUTO_TEST_CASE(testEntryReader)
+{
+
+	std::stringstream ss;
+
+	{
+		auto ar = Zip::MakeOutputArchive(&ss);
+
+		std::istringstream test1("Hello!");
+		std::istringstream test2(std::string(100000, 'z'));
+		std::istringstream test3("");
+
+		ar.entry("test1.txt") << test1;
+		ar.entry("test2.txt") << test2;
+		ar.entry("test3.txt") << test3;
+
+		ar.saveAndClose();
+	}
+
+	auto ar = Zip::MakeInputArchive(&ss);
+
+	std::vector<char> buffer;
+
+	BOOST_TEST(ar.readEntry(1, buffer) == 100000u);
+	BOOST_TEST(std::string(buffer.begin(), buffer.end()) == std::string(100000, 'z'));
+
+	// the capacity is kept for the next entries
+	const char* data = buffer.data();
+
+	BOOST_TEST(ar.readEntry(0, buffer) == 6u);
+	BOOST_TEST(std::string(buffer.begin(), buffer.end()) == "Hello!");
+	BOOST_TEST(buffer.data() == data);
+
+	BOOST_TEST(ar.readEntry(2, buffer) == 0u);
+	BOOST_CHECK_THROW(ar.readEntry(3, buffer), std::logic_error);
+
+	// the reader can be moved, the moved-from reader is closed
+	Zip::EntryReader reader;
+
+	BOOST_TEST(!reader);
+
+	reader = ar.openEntryReader(0);
+
+	Zip::EntryReader other(std::move(reader));
+
+	BOOST_TEST(!reader);
+	BOOST_TEST(bool(other));
+
+	char buff[16];
+
+	BOOST_TEST(other.read(buff, 2) == 2u);
+	BOOST_TEST(other.read(buff + 2, sizeof(buff) - 2) == 4u);
+	BOOST_TEST(other.read(buff, sizeof(buff)) == 0u);
+	BOOST_TEST(std::string(buff, 6) == "Hello!");
+
+}
+
+BOOST_AUTO_TEST_CASE(testPrefetchInputArchive)
+{
+
+	std::stringstream ss;
+
+	{
+		auto ar = Zip::MakeOutputArchive(&ss);
+
+		for (int i = 0; i < 10; i++) {
+			std::istringstream test(std::string(10000 * i, (char) ('a' + i)));
+			ar.entry("test" + std::to_string(i) + ".txt") << test;
+		}
+
+		ar.saveAndClose();
+	}
+
+	// small blocks, so reads span more of them
+	auto ar = Zip::MakePrefetchInputArchive(&ss, 1024, 2);
+
+	BOOST_TEST(ar.getNumOfEntries() == 10u);
+
+	for (int i = 9; i >= 0; i--) {
+
+		std::ostringstream test;
+		ar.entry("test" + std::to_string(i) + ".txt") >> test;
+
+		BOOST_TEST(test.str() == std::string(10000 * i, (char) ('a' + i)));
+
+	}
+
+}
+
+BOOST_AUTO_TEST_CASE(testPrefetchInputStream)
+{
+
+	// counts what is taken from the underlying stream
+	class CountingBuffer : public std::stringbuf {
+	public:
+
+		CountingBuffer(const std::string& data) :
+			std::stringbuf(data, std::ios::in),
+			numOfReadBytes(0),
+			numOfSeeks(0)
+		{}
+
+		std::atomic<long long> numOfReadBytes;
+		std::atomic<int> numOfSeeks;
+
+	protected:
+
+		std::streamsize xsgetn(char* s, std::streamsize n) override
+		{
+			std::streamsize nread = std::stringbuf::xsgetn(s, n);
+			numOfReadBytes += nread;
+			return nread;
+		}
+
+		pos_type seekoff(off_type off, std::ios::seekdir dir, std::ios::openmode which) override
+		{
+			if (off != 0 || dir != std::ios::cur) {
+				numOfSeeks++;
+			}
+
+			return std::stringbuf::seekoff(off, dir, which);
+		}
+
+		pos_type seekpos(pos_type pos, std::ios::openmode which) override
+		{
+			numOfSeeks++;
+			return std::stringbuf::seekpos(pos, which);
+		}
+
+	};
+
+	std::string content;
+
+	for (int i = 0; i < 1000; i++) {
+		content += (char) ('a' + i % 26);
+	}
+
+	CountingBuffer buffer(content);
+	std::istream is(&buffer);
+
+	Zip::PrefetchInputStream<std::istream*> ps(&is, 16, 2);
+
+	// waits for the worker to fill the queue
+	auto waitForReadBytes = [&buffer](long long numOfBytes)
+	{
+		for (int i = 0; i < 500 && buffer.numOfReadBytes < numOfBytes; i++) {
+			std::this_thread::sleep_for(std::chrono::milliseconds(10));
+		}
+
+		return buffer.numOfReadBytes.load();
+	};
+
+	char buf[1000];
+
+	auto read = [&ps, &buf](long long len)
+	{
+		ps.read(buf, len);
+		return std::string(buf, (std::size_t) ps.gcount());
+	};
+
+	// the first read goes to the input stream
+	BOOST_TEST(read(10) == content.substr(0, 10));
+	BOOST_TEST(buffer.numOfReadBytes == 10);
+
+	// the second sequential one starts reading ahead two blocks
+	BOOST_TEST(read(10) == content.substr(10, 10));
+	BOOST_TEST(waitForReadBytes(10 + 2 * 16) == 10 + 2 * 16);
+
+	// a seek within the queued blocks does not touch the input stream
+	int numOfSeeks = buffer.numOfSeeks;
+
+	ps.seekg(30, std::ios::beg);
+	BOOST_TEST(ps.tellg() == 30);
+	BOOST_TEST(read(5) == content.substr(30, 5));
+	BOOST_TEST(buffer.numOfSeeks == numOfSeeks);
+
+	// the released block makes room for the next one
+	BOOST_TEST(waitForReadBytes(10 + 3 * 16) == 10 + 3 * 16);
+
+	// a seek outside of them reads directly again
+	ps.seekg(5, std::ios::beg);
+	BOOST_TEST(read(5) == content.substr(5, 5));
+	BOOST_TEST(buffer.numOfSeeks > numOfSeeks);
+	BOOST_TEST(buffer.numOfReadBytes == 10 + 3 * 16 + 5);
+
+	// seeking from the end while reading ahead
+	BOOST_TEST(read(5) == content.substr(10, 5));
+	BOOST_TEST(waitForReadBytes(10 + 3 * 16 + 5 + 2 * 16) > 10 + 3 * 16 + 5);
+
+	ps.seekg(-4, std::ios::end);
+	BOOST_TEST(ps.tellg() == 996);
+	BOOST_TEST(read(4) == content.substr(996));
+
+	// the end of the stream while reading ahead
+	ps.seekg(900, std::ios::beg);
+	BOOST_TEST(read(10) == content.substr(900, 10));
+	BOOST_TEST(read(10) == content.substr(910, 10));
+
+	BOOST_TEST(read(1000) == content.substr(920));
+	BOOST_TEST(ps.eof());
+	BOOST_TEST(ps.fail());
+
+	ps.clear();
+	ps.seekg(0, std::ios::beg);
+	BOOST_TEST(read(10) == content.substr(0, 10));
+
+}
+
+BOOST_AUTO_TEST_CASE(testCrcCheck)
+{
+
+	const char* check = "123456789";
+
+	BOOST_TEST(Zip::Crc32::update(0, check, 9) == 0xCBF43926u);
+
+	std::string content;
+
+	for (int i = 0; i < 100000; i++) {
+		content += (char) ('a' + (i * 7) % 26);
+	}
+
+	// the crc continues over any split of the data
+	std::uint32_t crc = Zip::Crc32::update(0, content.data(), 1001);
+	crc = Zip::Crc32::update(crc, content.data() + 1001, content.size() - 1001);
+
+	BOOST_TEST(crc == Zip::Crc32::update(0, content.data(), content.size()));
+
+	std::vector<char> data;
+
+	{
+		auto ar = Zip::MakeOutputArchive(&data);
+
+		std::istringstream test1(content);
+		std::istringstream test2(content);
+
+		ar.entry("stored.txt").setCompression(Zip::CompressionPolicy::Store()) << test1;
+		ar.entry("deflated.txt") << test2;
+
+		ar.saveAndClose();
+	}
+
+	for (auto crcCheck : { Zip::CrcCheck::Default, Zip::CrcCheck::Verify, Zip::CrcCheck::Skip }) {
+
+		auto ar = Zip::MakeInputArchive(data.data(), data.size());
+		ar.setCrcCheck(crcCheck);
+
+		BOOST_TEST((ar.getCrcCheck() == crcCheck));
+
+		for (const char* entryPath : { "stored.txt", "deflated.txt" }) {
+			std::ostringstream test;
+			ar.entry(entryPath) >> test;
+			BOOST_TEST(test.str() == content);
+		}
+
+		// seeking stops the check but not the reading
+		auto is = ar.entry("stored.txt").openForReading();
+
+		char buf[10];
+
+		is->seekg(50000);
+		is->read(buf, sizeof(buf));
+		BOOST_TEST(std::string(buf, is->gcount()) == content.substr(50000, 10));
+
+		is->seekg(0);
+		is->read(buf, sizeof(buf));
+		BOOST_TEST(std::string(buf, is->gcount()) == content.substr(0, 10));
+
+	}
+
+	// damage the stored entry
+	auto pos = std::search(data.begin(), data.end(), content.begin(), content.end());
+
+	BOOST_REQUIRE(pos != data.end());
+
+	pos[50000] ^= 1;
+
+	for (auto crcCheck : { Zip::CrcCheck::Default, Zip::CrcCheck::Verify, Zip::CrcCheck::Skip }) {
+
+		auto ar = Zip::MakeInputArchive(data.data(), data.size());
+		ar.setCrcCheck(crcCheck);
+
+		std::ostringstream test;
+
+		if (crcCheck == Zip::CrcCheck::Skip) {
+			ar.entry("stored.txt") >> test;
+			BOOST_TEST(test.str().size() == content.size());
+			BOOST_TEST(test.str() != content);
+		}
+		else {
+			BOOST_CHECK_THROW(ar.entry("stored.txt") >> test, std::runtime_error);
+		}
+
+	}
+
+}
+
+BOOST_AUTO_TEST_CASE(testMemoryResource)
+{
+
+	auto arena = std::make_shared<Zip::MonotonicArena>(1024);
+
+	std::vector<char> data;
+
+	{
+		auto ar = Zip::MakeOutputArchive(&data);
+		ar.setMemoryResource(arena);
+
+		BOOST_TEST(ar.getMemoryResource() == arena);
+
+		for (int i = 0; i < 10; i++) {
+			std::istringstream test(std::string(1000 * i, (char) ('a' + i)));
+			ar.entry("test" + std::to_string(i) + ".txt") << test;
+		}
+
+		ar.saveAndClose();
+	}
+
+	std::size_t allocatedBytes = arena->getAllocatedBytes();
+
+	BOOST_TEST(allocatedBytes > 0u);
+
+	{
+		auto ar = Zip::MakeInputArchive(data.data(), data.size());
+		ar.setMemoryResource(arena);
+
+		for (int i = 0; i < 10; i++) {
+
+			std::ostringstream test;
+			ar.entry("test" + std::to_string(i) + ".txt") >> test;
+
+			BOOST_TEST(test.str() == std::string(1000 * i, (char) ('a' + i)));
+
+		}
+
+		// the resource cannot change under open entries
+		auto is = ar.entry("test1.txt").openForReading();
+
+		BOOST_CHECK_THROW(ar.setMemoryResource(nullptr), std::logic_error);
+	}
+
+	BOOST_TEST(arena->getAllocatedBytes() > allocatedBytes);
+
+	// nothing allocated from the arena is alive anymore
+	BOOST_TEST(arena.use_count() == 1);
+
+	{
+		std::weak_ptr<Zip::MonotonicArena> weakArena;
+		Zip::ReadableEntryStream::SharedPtr is;
+
+		{
+			auto ar = Zip::MakeInputArchive(data.data(), data.size());
+
+			auto streamArena = std::make_shared<Zip::MonotonicArena>();
+			weakArena = streamArena;
+
+			// the archive is the only owner of the arena
+			ar.setMemoryResource(streamArena);
+			streamArena.reset();
+
+			is = ar.entry("test1.txt").openForReading();
+		}
+
+		// the stream outlives its archive and keeps the arena alive
+		BOOST_TEST(!weakArena.expired());
+
+		char buf[10];
+		is->read(buf, sizeof(buf));
+
+		BOOST_TEST(is->fail());
+
+		is.reset();
+
+		BOOST_TEST(weakArena.expired());
+	}
+
+	// the allocator is usable with standard containers too
+	Zip::UnsynchronizedArena localArena;
+	Zip::ResourceAllocator<int> allocator(&localArena);
+	std::vector<int, Zip::ResourceAllocator<int>> values(allocator);
+
+	for (int i = 0; i < 1000; i++) {
+		values.push_back(i);
+	}
+
+	BOOST_TEST(std::accumulate(values.begin(), values.end(), 0) == 499500);
+	BOOST_TEST(localArena.getAllocatedBytes() >= 1000 * sizeof(int));
+
+	// the default resource is not reference counted
+	BOOST_TEST(Zip::MemoryResource::getDefault().use_count() == 0);
+
+}
+
+BOOST_AUTO_TEST_CASE(testLazyArchive)
+{
+
+	std::vector<char> data;
+
+	{
+		auto ar = Zip::MakeOutputArchive(&data);
+
+		for (int i = 0; i < 100; i++) {
+
+			std::istringstream test(std::string(1000 * i, (char) ('a' + i % 26)));
+
+			auto entry = ar.entry("test" + std::to_string(i) + ".txt");
+
+			if (i % 2) {
+				entry.setCompression(Zip::CompressionPolicy::Store());
+			}
+
+			entry << test;
+
+		}
+
+		ar.saveAndClose();
+	}
+
+	Zip::LazyArchive ar(data.data(), data.size());
+
+	// only the end of the central directory has been read
+	BOOST_TEST(ar.getNumOfEntries() == 100u);
+	BOOST_TEST(ar.getNumOfParsedEntries() == 0u);
+
+	std::vector<char> buffer;
+
+	BOOST_TEST(ar.readEntry("test9.txt", buffer) == 9000u);
+	BOOST_TEST(std::string(buffer.begin(), buffer.end()) == std::string(9000, 'j'));
+	BOOST_TEST(ar.getNumOfParsedEntries() == 10u);
+
+	// records passed on the way are remembered
+	BOOST_TEST(ar.readEntry("test2.txt", buffer) == 2000u);
+	BOOST_TEST(std::string(buffer.begin(), buffer.end()) == std::string(2000, 'c'));
+	BOOST_TEST(ar.getNumOfParsedEntries() == 10u);
+
+	std::ostringstream test;
+
+	ar.exportTo("test99.txt", [&test](const char* chunk, std::size_t len)
+	{
+		test.write(chunk, len);
+	});
+
+	BOOST_TEST(test.str() == std::string(99000, 'v'));
+	BOOST_TEST(ar.getNumOfParsedEntries() == 100u);
+
+	BOOST_TEST(!ar.hasEntry("missing.txt"));
+	BOOST_CHECK_THROW(ar.readEntry("missing.txt", buffer), std::logic_error);
+
+	std::size_t numOfEntries = 0;
+
+	ar.forEachEntry([&numOfEntries](const Zip::LazyArchive::EntryInfo& info)
+	{
+		BOOST_TEST(info.size == 1000u * numOfEntries);
+
+		if (numOfEntries > 0) {
+			// libzip may store the empty entry
+			BOOST_TEST(info.method == (numOfEntries % 2 ? 0 : 8));
+		}
+
+		numOfEntries++;
+	});
+
+	BOOST_TEST(numOfEntries == 100u);
+
+	// damage a stored entry
+	auto info = ar.getEntryInfo("test1.txt");
+	auto pos = std::search_n(
+		data.begin() + info.localHeaderOffset,
+		data.end(),
+		(std::size_t) 1000,
+		'b'
+	);
+
+	pos[500] = 'x';
+
+	BOOST_CHECK_THROW(ar.readEntry("test1.txt", buffer), std::runtime_error);
+
+	ar.setCrcCheck(Zip::CrcCheck::Skip);
+
+	BOOST_TEST(ar.readEntry("test1.txt", buffer) == 1000u);
+	BOOST_TEST(buffer[500] == 'x');
+
+	BOOST_CHECK_THROW(Zip::LazyArchive(data.data(), 10), std::runtime_error);
+
+}
+
+BOOST_AUTO_TEST_CASE(testSidecarIndex)
+{
+
+	const char* filePath = "testSidecarIndex.zip";
+	const char* indexPath = "testSidecarIndex.idx";
+
+	{
+		std::ofstream fs(filePath, std::ios::binary);
+		auto ar = Zip::MakeOutputArchive(&fs);
+
+		for (int i = 0; i < 100; i++) {
+			std::istringstream test(std::string(100 * i, (char) ('a' + i % 26)));
+			ar.entry("dir/test" + std::to_string(i) + ".txt") << test;
+		}
+
+		ar.saveAndClose();
+	}
+
+	std::remove(indexPath);
+
+	{
+		// the index is written on the first open
+		auto ar = Zip::OpenLazyArchive(filePath, indexPath);
+
+		BOOST_REQUIRE(ar->getIndex());
+		BOOST_TEST(ar->getIndex()->getNumOfEntries() == 100u);
+	}
+
+	{
+		auto index = Zip::SidecarIndex::open(indexPath);
+
+		BOOST_REQUIRE(index);
+
+		auto ar = Zip::OpenLazyArchive(filePath, indexPath);
+
+		std::vector<char> buffer;
+
+		for (int i = 99; i >= 0; i--) {
+			BOOST_TEST(ar->readEntry("dir/test" + std::to_string(i) + ".txt", buffer) == 100u * i);
+			BOOST_TEST(std::string(buffer.begin(), buffer.end()) == std::string(100 * i, (char) ('a' + i % 26)));
+		}
+
+		BOOST_TEST(!ar->hasEntry("dir/test100.txt"));
+
+		// nothing has been read from the central directory
+		BOOST_TEST(ar->getNumOfParsedEntries() == 0u);
+
+		// an index of another archive is not used
+		auto key = ar->getIndexKey(Zip::SidecarIndex::getFileMTime(filePath));
+
+		BOOST_TEST(index->matches(key));
+
+		key.archiveMTime++;
+
+		BOOST_TEST(!index->matches(key));
+	}
+
+	{
+		std::ofstream fs(indexPath, std::ios::binary);
+		fs << "not an index";
+	}
+
+	BOOST_TEST(!Zip::SidecarIndex::open(indexPath));
+
+	// a broken index is replaced
+	BOOST_TEST(Zip::OpenLazyArchive(filePath, indexPath)->getIndex() != nullptr);
+	BOOST_TEST(Zip::SidecarIndex::open(indexPath) != nullptr);
+
+	std::remove(indexPath);
+
+	{
+		// more processes may write the missing index at the same time
+		std::vector<std::future<Zip::LazyArchive::SharedPtr>> opens;
+
+		for (int i = 0; i < 2; i++) {
+			opens.push_back(std::async(std::launch::async, [&]()
+			{
+				return Zip::OpenLazyArchive(filePath, indexPath);
+			}));
+		}
+
+		for (auto& open : opens) {
+			auto ar = open.get();
+
+			std::vector<char> buffer;
+
+			BOOST_TEST(ar->readEntry("dir/test42.txt", buffer) == 4200u);
+			BOOST_TEST(std::string(buffer.begin(), buffer.end()) == std::string(4200, 'q'));
+		}
+
+		auto index = Zip::SidecarIndex::open(indexPath);
+
+		BOOST_REQUIRE(index);
+		BOOST_TEST(index->getNumOfEntries() == 100u);
+	}
+
+	{
+		// the index cannot be written, the central directory is used instead
+		auto ar = Zip::OpenLazyArchive(filePath, "missingDir/testSidecarIndex.idx");
+
+		BOOST_TEST(ar->getIndex() == nullptr);
+
+		std::vector<char> buffer;
+
+		BOOST_TEST(ar->readEntry("dir/test42.txt", buffer) == 4200u);
+		BOOST_TEST(ar->hasEntry("dir/test99.txt"));
+		BOOST_TEST(!ar->hasEntry("dir/test100.txt"));
+	}
+
+	std::remove(indexPath);
+	std::remove(filePath);
+
+}
+
 BOOST_AUTO_TEST_SUITE_END()
\ No newline at end of file
@@ -0,0 +1,90 @@
+#include <boost/test/unit_test.hpp>
+#include "../VsTestExplorer.h"
+
+// the other tests of the program use the default policy,
+// the code of each policy lives in a namespace of its own
+#define ZIPCPP_METRICS_POLICY AtomicMetrics
+
+#include <ZipCpp/ZipCpp.h>
+
+#include <numeric>
+
+BOOST_AUTO_TEST_SUITE(Archive__Metrics)
+
+BOOST_AUTO_TEST_CASE(testMetrics)
+{
+
+	typedef Zip::AtomicMetrics Metrics;
+
+	Metrics::reset();
+
+	std::string entryName;
+	zip_uint64_t entrySize = 0;
+	zip_uint64_t entryCompSize = 0;
+
+	Metrics::setEntrySizesHandler(
+		[&](const char* name, zip_uint64_t size, zip_uint64_t compSize)
+		{
+			entryName = name;
+			entrySize = size;
+			entryCompSize = compSize;
+		}
+	);
+
+	std::stringstream ss;
+
+	{
+		auto ar = Zip::MakeOutputArchive(&ss);
+
+		std::istringstream test(std::string(100000, 'z'));
+		ar.entry("test.txt") << test;
+
+		ar.saveAndClose();
+	}
+
+	BOOST_TEST(Metrics::getCount(Zip::MetricId::EntryWriteBytes) == 100000u);
+	BOOST_TEST(Metrics::getCount(Zip::MetricId::SourceWrites) > 0u);
+	BOOST_TEST(Metrics::getCount(Zip::MetricId::SourceWriteBytes) >= ss.str().size());
+
+	auto saveTimes = Metrics::getHistogram(Zip::MetricId::SaveAndCloseTime);
+	BOOST_TEST(std::accumulate(saveTimes.begin(), saveTimes.end(), (std::uint64_t) 0) == 1u);
+
+	{
+		auto ar = Zip::MakeInputArchive(&ss);
+
+		std::ostringstream test;
+		ar.entry("test.txt") >> test;
+	}
+
+	BOOST_TEST(Metrics::getCount(Zip::MetricId::EntryOpens) == 1u);
+	BOOST_TEST(Metrics::getCount(Zip::MetricId::EntryReadBytes) == 100000u);
+	BOOST_TEST(Metrics::getCount(Zip::MetricId::SourceReads) > 0u);
+
+	BOOST_TEST(entryName == "test.txt");
+	BOOST_TEST(entrySize == 100000u);
+	BOOST_TEST(entryCompSize < entrySize);
+
+	int numOfCalls = 0;
+
+	// the handler may replace itself
+	Metrics::setEntrySizesHandler(
+		[&](const char*, zip_uint64_t, zip_uint64_t)
+		{
+			numOfCalls++;
+			Metrics::setEntrySizesHandler(nullptr);
+		}
+	);
+
+	for (int i = 0; i < 2; i++) {
+		auto ar = Zip::MakeInputArchive(&ss);
+
+		std::ostringstream test;
+		ar.entry("test.txt") >> test;
+	}
+
+	BOOST_TEST(numOfCalls == 1);
+	BOOST_TEST(Metrics::getCount(Zip::MetricId::EntryOpens) == 3u);
+
+}
+
+BOOST_AUTO_TEST_SUITE_END()